@@ -15,6 +15,7 @@ import (
 	"github.com/azure/azure-dev/cli/azd/pkg/azapi"
 	"github.com/azure/azure-dev/cli/azd/pkg/exec"
 	"github.com/azure/azure-dev/cli/azd/pkg/lazy"
+	"github.com/azure/azure-dev/cli/azd/pkg/oneauth"
 	"github.com/azure/azure-dev/cli/azd/pkg/platform"
 	"github.com/spf13/pflag"
 )
@@ -71,6 +72,9 @@ func (m *TelemetryMiddleware) Run(ctx context.Context, next NextFn) (*actions.Ac
 	defer func() {
 		// Include any usage attributes set
 		span.SetAttributes(tracing.GetUsageAttributes()...)
+		if stats, ok := oneauth.GetBridgeStats(); ok {
+			span.SetAttributes(stats.Attributes()...)
+		}
 		span.SetAttributes(fields.PerfInteractTime.Int64(tracing.InteractTimeMs.Load()))
 		span.End()
 	}()
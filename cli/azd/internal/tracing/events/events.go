@@ -27,6 +27,9 @@ const PackCliInstallEvent = "tools.pack.install"
 // PackBuildEvent is the name of the event which tracks the overall pack build operation.
 const PackBuildEvent = "tools.pack.build"
 
+// OneAuthTokenEvent is the name of the event which tracks a token request that reached OneAuth.
+const OneAuthTokenEvent = "auth.oneauth.token"
+
 // AccountSubscriptionsListEvent is the name of the event which tracks listing of account subscriptions .
 // See fields.AccountSubscriptionsListTenantsFound for additional event fields.
 const AccountSubscriptionsListEvent = "account.subscriptions.list"
@@ -226,6 +226,33 @@ const (
 	PerfInteractTime = attribute.Key("perf.interact_time")
 )
 
+// OneAuth related fields
+const (
+	// Histograms of the durations of OneAuth bridge operations. Element 0 counts operations taking less than 1 millisecond,
+	// element i those taking at least 2^(i-1) and less than 2^i milliseconds, and the last element all longer operations.
+	OneAuthStartupDurations     = attribute.Key("perf.oneauth.startup")
+	OneAuthReadAccountDurations = attribute.Key("perf.oneauth.read_account")
+	OneAuthSilentDurations      = attribute.Key("perf.oneauth.silent")
+	OneAuthInteractiveDurations = attribute.Key("perf.oneauth.interactive")
+	OneAuthPumpDurations        = attribute.Key("perf.oneauth.pump")
+	OneAuthLogoutDurations      = attribute.Key("perf.oneauth.logout")
+
+	// The number of OneAuth requests the bridge stopped waiting for.
+	OneAuthTimeouts = attribute.Key("perf.oneauth.timeouts")
+	// The number of OneAuth requests that returned an error.
+	OneAuthErrors = attribute.Key("perf.oneauth.errors")
+
+	// The ID OneAuth's telemetry and logs associate with a token request.
+	OneAuthCorrelationId = attribute.Key("oneauth.correlationId")
+
+	// The time a token request spent in each phase, in microseconds: finding the account and starting silent
+	// authentication, waiting for silent authentication, pumping messages for a login window, and building the result.
+	OneAuthAccountLookupTime = attribute.Key("perf.oneauth.account_lookup_us")
+	OneAuthSilentWaitTime    = attribute.Key("perf.oneauth.silent_wait_us")
+	OneAuthPumpTime          = attribute.Key("perf.oneauth.pump_us")
+	OneAuthMarshalTime       = attribute.Key("perf.oneauth.marshal_us")
+)
+
 // Pack related fields
 const (
 	// The builder image used. Hashed when a user-defined image is used.
@@ -26,6 +26,7 @@ import (
 	"github.com/azure/azure-dev/cli/azd/cmd"
 	"github.com/azure/azure-dev/cli/azd/internal"
 	"github.com/azure/azure-dev/cli/azd/internal/telemetry"
+	"github.com/azure/azure-dev/cli/azd/pkg/auth"
 	"github.com/azure/azure-dev/cli/azd/pkg/config"
 	"github.com/azure/azure-dev/cli/azd/pkg/installer"
 	"github.com/azure/azure-dev/cli/azd/pkg/ioc"
@@ -55,6 +56,11 @@ func main() {
 
 	log.Printf("azd version: %s", internal.Version)
 
+	// extract and load the OneAuth bridge while azd initializes, in case the command authenticates with OneAuth,
+	// and start OneAuth if the current user logged in with it
+	oneauth.Preload()
+	auth.StartOneAuth()
+
 	ts := telemetry.GetTelemetrySystem()
 
 	latest := make(chan semver.Version)
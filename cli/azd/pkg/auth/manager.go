@@ -186,6 +186,27 @@ func EnsureLoggedInCredential(
 	return &token, nil
 }
 
+// StartOneAuth begins starting OneAuth in the background when the current user logged in with it, so that a
+// command's first token request needn't wait for OneAuth to start. azd calls it before dispatching a command.
+func StartOneAuth() {
+	if !oneauth.Supported {
+		return
+	}
+	go func() {
+		cfgPath, err := config.GetUserConfigDir()
+		if err != nil {
+			return
+		}
+		cfg, err := config.NewFileConfigManager(config.NewManager()).Load(filepath.Join(cfgPath, cAuthConfigFileName))
+		if err != nil {
+			return
+		}
+		if user, err := readUserProperties(cfg); err == nil && user.FromOneAuth {
+			oneauth.StartAsync(cAZD_CLIENT_ID)
+		}
+	}()
+}
+
 // CredentialForCurrentUser returns a TokenCredential instance for the current user. If `auth.useLegacyAzCliAuth` is set to
 // a truthy value in config, an instance of azidentity.AzureCLICredential is returned instead. To accept the default options,
 // pass nil.
@@ -271,6 +292,9 @@ func (m *Manager) CredentialForCurrentUser(
 				return nil, fmt.Errorf("joining authority url: %w", err)
 			}
 
+			// start OneAuth and acquire an ARM token while the command initializes, so its first token request
+			// needn't wait for either
+			oneauth.Warmup(authority, cAZD_CLIENT_ID, *currentUser.HomeAccountID)
 			return oneauth.NewCredential(authority, cAZD_CLIENT_ID, oneauth.CredentialOptions{
 				HomeAccountID: *currentUser.HomeAccountID,
 				NoPrompt:      options.NoPrompt,
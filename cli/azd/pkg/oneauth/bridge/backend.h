@@ -0,0 +1,55 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "pending_auth.h"
+#include "pump.h"
+#include <functional>
+#include <memory>
+#include <string>
+
+// BackendAccount is an account read from a Backend. Backends derive from it to keep their own account data.
+struct BackendAccount
+{
+    virtual ~BackendAccount() = default;
+    std::string id;
+};
+
+// BackendLogCallback receives a backend's log messages. level is as for SetLogOptions in bridge.h.
+// identifiable is true when the message may contain personally identifiable information.
+typedef void (*BackendLogCallback)(int level, const char *message, bool identifiable);
+
+// Backend is the authentication service behind the bridge's exports: OneAuth in production, or a fake that
+// lets the bridge build, run and be tested off Windows. Backends may invoke callbacks on any thread, including
+// the calling thread before returning. Parameters named correlationID come from NewCorrelationID.
+class Backend
+{
+public:
+    using Callback = std::function<void(TokenResult)>;
+
+    virtual ~Backend() = default;
+
+    // Startup starts the backend. It returns an error message, or an empty string when it succeeds.
+    virtual std::string Startup(const std::string &clientID, const std::string &applicationID, const std::string &version) = 0;
+    virtual void Shutdown() = 0;
+    // SetLogging sets the most verbose level of messages the backend sends to callback
+    virtual void SetLogging(int level, BackendLogCallback callback) = 0;
+    // NewCorrelationID returns an ID that correlates a request with the backend's telemetry and logs
+    virtual std::string NewCorrelationID() = 0;
+    // ReadAccount returns the account having the given ID, or nullptr when there's no such account
+    virtual std::shared_ptr<BackendAccount> ReadAccount(const std::string &accountID, const std::string &correlationID) = 0;
+    virtual void AcquireTokenSilently(const BackendAccount &account, const std::string &authority, const std::string &scope, const std::string &correlationID, Callback callback) = 0;
+    // SignInInteractively displays a login window. The caller must pump the window's messages with an
+    // EventSource from NewEventSource until the backend invokes callback.
+    virtual void SignInInteractively(const std::string &authority, const std::string &scope, const std::string &correlationID, Callback callback) = 0;
+    // SignInSilently signs in the system's default account
+    virtual void SignInSilently(const std::string &correlationID, Callback callback) = 0;
+    // SignOut disassociates the application from all its accounts
+    virtual void SignOut() = 0;
+    // NewEventSource returns an EventSource for the calling thread
+    virtual std::shared_ptr<EventSource> NewEventSource() = 0;
+};
+
+// NewBackend returns the backend this build of the bridge uses
+std::unique_ptr<Backend> NewBackend();
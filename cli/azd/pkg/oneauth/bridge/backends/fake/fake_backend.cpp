@@ -0,0 +1,254 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "fake_backend.h"
+#include "backend.h"
+#include "clock.h"
+#include "fake_correlation_id.h"
+#include "fake_event_source.h"
+#include "replay_backend.h"
+#include "scheduler.h"
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    const char *fakeAccountID = "fake-account";
+
+    struct Counts
+    {
+        std::atomic<uint64_t> startup{0};
+        std::atomic<uint64_t> readAccount{0};
+        std::atomic<uint64_t> acquireSilently{0};
+        std::atomic<uint64_t> signInInteractively{0};
+        std::atomic<uint64_t> signInSilently{0};
+        std::atomic<uint64_t> signOut{0};
+        std::atomic<uint64_t> shutdown{0};
+        std::atomic<uint64_t> foreignShutdowns{0};
+    };
+
+    std::mutex optionsMu;
+    FakeBackendOptions options{};
+    Counts counts;
+
+    // manualClock lives as long as the bridge because threads may still be using it after a caller restores the
+    // system clocks
+    ManualClock manualClock;
+
+    std::atomic<BackendLogCallback> logCallback{nullptr};
+    std::atomic<int> logLevel{0};
+
+    void log(int level, const char *operation, const std::string &detail)
+    {
+        auto callback = logCallback.load();
+        if (callback && level <= logLevel.load())
+        {
+            auto message = std::string("fake backend: ") + operation + " " + detail;
+            callback(level, message.c_str(), false);
+        }
+    }
+
+    FakeBackendOptions currentOptions()
+    {
+        std::lock_guard<std::mutex> lock(optionsMu);
+        return options;
+    }
+
+    class FakeBackend : public Backend
+    {
+    public:
+        std::string Startup(const std::string &, const std::string &applicationID, const std::string &) override
+        {
+            counts.startup++;
+            startupThread = std::this_thread::get_id();
+            auto op = currentOptions().startup;
+            log(3, "Startup", applicationID);
+            block(op);
+            if (op.fail)
+            {
+                log(1, "Startup failed", applicationID);
+                return "fake startup failure";
+            }
+            return "";
+        }
+
+        void Shutdown() override
+        {
+            counts.shutdown++;
+            if (std::this_thread::get_id() != startupThread.load())
+            {
+                counts.foreignShutdowns++;
+            }
+            scheduler.Stop();
+        }
+
+        void SetLogging(int level, BackendLogCallback callback) override
+        {
+            logCallback.store(callback);
+            logLevel.store(level);
+        }
+
+        std::string NewCorrelationID() override
+        {
+            return FakeCorrelationID(++correlationIDs);
+        }
+
+        std::shared_ptr<BackendAccount> ReadAccount(const std::string &accountID, const std::string &correlationID) override
+        {
+            counts.readAccount++;
+            auto op = currentOptions().readAccount;
+            log(3, "ReadAccount", correlationID);
+            block(op);
+            if (op.fail || accountID.empty())
+            {
+                return nullptr;
+            }
+            auto account = std::make_shared<BackendAccount>();
+            account->id = accountID;
+            return account;
+        }
+
+        void AcquireTokenSilently(const BackendAccount &account, const std::string &, const std::string &, const std::string &correlationID, Callback callback) override
+        {
+            counts.acquireSilently++;
+            auto o = currentOptions();
+            complete(o.acquireSilently, "AcquireTokenSilently", correlationID, account.id, o, std::move(callback));
+        }
+
+        void SignInInteractively(const std::string &, const std::string &, const std::string &correlationID, Callback callback) override
+        {
+            counts.signInInteractively++;
+            auto o = currentOptions();
+            complete(o.signInInteractively, "SignInInteractively", correlationID, fakeAccountID, o, std::move(callback));
+        }
+
+        void SignInSilently(const std::string &correlationID, Callback callback) override
+        {
+            counts.signInSilently++;
+            auto o = currentOptions();
+            complete(o.signInSilently, "SignInSilently", correlationID, fakeAccountID, o, std::move(callback));
+        }
+
+        void SignOut() override
+        {
+            counts.signOut++;
+            log(3, "SignOut", "");
+        }
+
+        std::shared_ptr<EventSource> NewEventSource() override
+        {
+            return std::make_shared<FakeEventSource>();
+        }
+
+    private:
+        // block simulates the latency of an operation that doesn't have a callback
+        void block(const FakeOperation &op)
+        {
+            if (op.latencyMilliseconds > 0)
+            {
+                SleepFor(GetClock(), std::chrono::milliseconds(op.latencyMilliseconds));
+            }
+        }
+
+        // complete calls callback as op specifies, with a new token for the given account or an error
+        void complete(const FakeOperation &op, const char *operation, const std::string &correlationID, const std::string &accountID, const FakeBackendOptions &o, Callback callback)
+        {
+            log(3, operation, correlationID);
+            if (op.dropCallback)
+            {
+                return;
+            }
+            TokenResult result;
+            if (op.fail)
+            {
+                log(1, operation, correlationID + " failed");
+                result.error = std::string("fake ") + operation + " failure";
+            }
+            else
+            {
+                auto lifetime = std::chrono::seconds(o.tokenLifetimeSeconds > 0 ? o.tokenLifetimeSeconds : 3600);
+                result.accountID = accountID;
+                result.expiresOn = std::chrono::time_point_cast<std::chrono::system_clock::duration>(GetClock().SystemNow() + lifetime);
+                result.token = "fake-token-" + std::to_string(++tokens);
+                if (static_cast<int32_t>(result.token.size()) < o.tokenLength)
+                {
+                    result.token.resize(o.tokenLength, 'x');
+                }
+            }
+            if (op.latencyMilliseconds <= 0)
+            {
+                callback(std::move(result));
+                return;
+            }
+            scheduler.After(std::chrono::milliseconds(op.latencyMilliseconds), [callback = std::move(callback), result = std::move(result)]() mutable
+                            { callback(std::move(result)); });
+        }
+
+        std::atomic<uint64_t> correlationIDs{0};
+        std::atomic<uint64_t> tokens{0};
+        Scheduler scheduler;
+        std::atomic<std::thread::id> startupThread;
+    };
+}
+
+// NewBackend returns a backend replaying the trace AZD_ONEAUTH_REPLAY_FILE names, when it names one
+std::unique_ptr<Backend> NewBackend()
+{
+    auto p = std::getenv("AZD_ONEAUTH_REPLAY_FILE");
+    if (p && *p)
+    {
+        return NewReplayBackend(p);
+    }
+    return std::make_unique<FakeBackend>();
+}
+
+void ConfigureFakeBackend(const FakeBackendOptions *o)
+{
+    {
+        std::lock_guard<std::mutex> lock(optionsMu);
+        options = o ? *o : FakeBackendOptions{};
+    }
+    counts.startup = 0;
+    counts.readAccount = 0;
+    counts.acquireSilently = 0;
+    counts.signInInteractively = 0;
+    counts.signInSilently = 0;
+    counts.signOut = 0;
+    counts.shutdown = 0;
+    counts.foreignShutdowns = 0;
+}
+
+void GetFakeBackendCounts(FakeBackendCounts *c)
+{
+    if (c)
+    {
+        c->startup = counts.startup.load();
+        c->readAccount = counts.readAccount.load();
+        c->acquireSilently = counts.acquireSilently.load();
+        c->signInInteractively = counts.signInInteractively.load();
+        c->signInSilently = counts.signInSilently.load();
+        c->signOut = counts.signOut.load();
+        c->shutdown = counts.shutdown.load();
+        c->foreignShutdowns = counts.foreignShutdowns.load();
+    }
+}
+
+void FakeBackendLog(int level, const char *message)
+{
+    if (auto callback = logCallback.load())
+    {
+        callback(level, message, false);
+    }
+}
+
+void UseManualClock(bool manual)
+{
+    SetClock(manual ? &manualClock : nullptr);
+}
+
+void AdvanceClock(int64_t milliseconds)
+{
+    manualClock.Advance(std::chrono::milliseconds(milliseconds));
+}
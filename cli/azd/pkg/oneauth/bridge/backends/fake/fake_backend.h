@@ -0,0 +1,74 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "bridge.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // FakeOperation configures how the fake backend performs an operation
+    typedef struct
+    {
+        // latencyMilliseconds is how long the operation takes. Operations having a callback call it after this long
+        // on a thread of the fake's; operations without one block the caller. 0 completes the operation immediately
+        // on the calling thread.
+        int32_t latencyMilliseconds;
+        // fail makes the operation fail
+        bool fail;
+        // dropCallback makes the operation never call its callback, as OneAuth sometimes does
+        bool dropCallback;
+    } FakeOperation;
+
+    // FakeBackendOptions configures the fake backend. Zero values complete every operation immediately and successfully.
+    typedef struct
+    {
+        FakeOperation startup;
+        FakeOperation readAccount;
+        FakeOperation acquireSilently;
+        FakeOperation signInInteractively;
+        FakeOperation signInSilently;
+        // tokenLifetimeSeconds is the lifetime of the fake's tokens. When it's 0, tokens are valid for an hour.
+        int32_t tokenLifetimeSeconds;
+        // tokenLength pads the fake's tokens to this many characters, to simulate the size of real tokens
+        int32_t tokenLength;
+    } FakeBackendOptions;
+
+    // FakeBackendCounts are the numbers of times the fake backend started each operation
+    typedef struct
+    {
+        uint64_t startup;
+        uint64_t readAccount;
+        uint64_t acquireSilently;
+        uint64_t signInInteractively;
+        uint64_t signInSilently;
+        uint64_t signOut;
+        uint64_t shutdown;
+        // foreignShutdowns counts calls to Shutdown on a thread other than the one that called Startup. OneAuth must shut down
+        // on the thread that started it, to uninitialize that thread's OLE afterward.
+        uint64_t foreignShutdowns;
+    } FakeBackendCounts;
+
+    // ConfigureFakeBackend sets the fake backend's options, affecting operations started afterward. NULL restores the defaults.
+    // It also resets the fake's counts.
+    BRIDGE_API void ConfigureFakeBackend(const FakeBackendOptions *options);
+
+    // GetFakeBackendCounts reports how many times the fake backend started each operation
+    BRIDGE_API void GetFakeBackendCounts(FakeBackendCounts *counts);
+
+    // FakeBackendLog sends a message to the bridge as the backend's log callback would. level is as for SetLogOptions.
+    BRIDGE_API void FakeBackendLog(int level, const char *message);
+
+    // UseManualClock, when manual is true, makes the bridge and the fake backend take time for deadlines, timeouts, latency
+    // and token expiry from a clock that moves only when AdvanceClock is called. Otherwise, they use the system's clocks.
+    BRIDGE_API void UseManualClock(bool manual);
+
+    // AdvanceClock advances the manual clock
+    BRIDGE_API void AdvanceClock(int64_t milliseconds);
+
+#ifdef __cplusplus
+}
+#endif
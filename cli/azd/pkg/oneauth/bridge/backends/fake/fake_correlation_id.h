@@ -0,0 +1,17 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// FakeCorrelationID returns a version 4 UUID whose last field is n, so backends that don't call a service can
+// number their correlation IDs and tests can tell them apart
+inline std::string FakeCorrelationID(uint64_t n)
+{
+    char id[37];
+    snprintf(id, sizeof(id), "00000000-0000-4000-8000-%012llx", static_cast<unsigned long long>(n));
+    return id;
+}
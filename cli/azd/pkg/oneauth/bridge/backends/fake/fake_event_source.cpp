@@ -0,0 +1,65 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "fake_event_source.h"
+
+PumpEvent FakeEventSource::Wait(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mu);
+    if (!cv.wait_for(lock, timeout, [this]
+                     { return messages > 0 || signaled || failed; }))
+    {
+        return PumpEvent::Timeout;
+    }
+    if (failed)
+    {
+        return PumpEvent::Failed;
+    }
+    // like MsgWaitForMultipleObjectsEx, prefer the signal to input
+    if (signaled)
+    {
+        signaled = false;
+        return PumpEvent::Signaled;
+    }
+    return PumpEvent::Message;
+}
+
+void FakeEventSource::Dispatch()
+{
+    std::lock_guard<std::mutex> lock(mu);
+    dispatched += messages;
+    messages = 0;
+}
+
+void FakeEventSource::Signal()
+{
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        signaled = true;
+    }
+    cv.notify_all();
+}
+
+void FakeEventSource::Post()
+{
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        messages++;
+    }
+    cv.notify_all();
+}
+
+int FakeEventSource::Dispatched()
+{
+    std::lock_guard<std::mutex> lock(mu);
+    return dispatched;
+}
+
+void FakeEventSource::Fail()
+{
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        failed = true;
+    }
+    cv.notify_all();
+}
@@ -0,0 +1,33 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "pump.h"
+#include <condition_variable>
+#include <mutex>
+
+// FakeEventSource is an EventSource without a message queue. Post simulates the arrival of a message.
+class FakeEventSource : public EventSource
+{
+public:
+    PumpEvent Wait(std::chrono::milliseconds timeout) override;
+    void Dispatch() override;
+    void Signal() override;
+
+    // Post queues a message for Dispatch. It may be called from any thread.
+    void Post();
+    // Dispatched returns the number of messages Dispatch has dispatched
+    int Dispatched();
+    // Fail makes every later Wait fail, as a wait on an invalid handle does
+    void Fail();
+
+private:
+    std::condition_variable cv;
+    std::mutex mu;
+    int dispatched = 0;
+    int messages = 0;
+    bool failed = false;
+    // signaled resets when Wait returns Signaled, so each Signal wakes one Wait, like an auto-reset event
+    bool signaled = false;
+};
@@ -0,0 +1,225 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "backend.h"
+#include "win32_event_source.h"
+#include <OneAuth/OneAuthWin.hpp>
+#include <atomic>
+#include <windows.h>
+
+using namespace Microsoft::Authentication;
+using Microsoft::Authentication::UUID;
+
+namespace
+{
+    // OneAuthAccount is a BackendAccount holding the OneAuth account OneAuth's methods require
+    struct OneAuthAccount : BackendAccount
+    {
+        std::shared_ptr<Account> account;
+    };
+
+    // OneAuth calls log on its own threads
+    std::atomic<BackendLogCallback> logCallback{nullptr};
+
+    void log(LogLevel level, const char *message, int identifiableInformation)
+    {
+        if (auto callback = logCallback.load())
+        {
+            // the bridge's levels are one less than OneAuth's
+            callback(static_cast<int>(level) - 1, message, identifiableInformation != 0);
+        }
+    }
+
+    // toTokenResult copies the data from a OneAuth AuthResult. An AuthResult itself can't be returned to Go
+    // because it contains shared_ptrs that may be freed before Go is done with them.
+    TokenResult toTokenResult(const AuthResult &ar)
+    {
+        TokenResult result;
+        if (auto account = ar.GetAccount())
+        {
+            result.accountID = account->GetId();
+        }
+        if (auto credential = ar.GetCredential())
+        {
+            result.expiresOn = credential->GetExpiresOn();
+            result.token = credential->GetValue();
+        }
+        if (auto error = ar.GetError())
+        {
+            result.error = error->ToString();
+        }
+        return result;
+    }
+
+    std::function<void(const AuthResult &)> adapt(Backend::Callback callback)
+    {
+        return [callback = std::move(callback)](const AuthResult &ar)
+        {
+            callback(toTokenResult(ar));
+        };
+    }
+
+    // oleThread initializes OLE on a thread and uninitializes it when the thread exits, unless Uninitialize did so
+    // first. OneAuth requires OLE on the thread that starts it and on the thread pumping messages for a login window,
+    // which differ when the bridge starts OneAuth asynchronously.
+    struct oleThread
+    {
+        HRESULT result = E_FAIL;
+
+        ~oleThread()
+        {
+            Uninitialize();
+        }
+
+        // Initialize initializes OLE, if it isn't already, and returns true when OLE is initialized
+        bool Initialize()
+        {
+            if (!Initialized())
+            {
+                result = OleInitialize(NULL);
+            }
+            return Initialized();
+        }
+
+        bool Initialized() const
+        {
+            return result == S_OK || result == S_FALSE;
+        }
+
+        void Uninitialize()
+        {
+            if (Initialized())
+            {
+                OleUninitialize();
+                result = E_FAIL;
+            }
+        }
+    };
+
+    // threadOle returns the calling thread's OLE state
+    oleThread &threadOle()
+    {
+        thread_local oleThread ole;
+        return ole;
+    }
+
+    TelemetryParameters telemetry(const std::string &correlationID)
+    {
+        return TelemetryParameters(UUID::FromString(correlationID));
+    }
+
+    class OneAuthBackend : public Backend
+    {
+    public:
+        std::string Startup(const std::string &clientID, const std::string &applicationID, const std::string &version) override
+        {
+            if (!threadOle().Initialize())
+            {
+                return "OleInitialize failed";
+            }
+
+            auto appConfig = AppConfiguration(applicationID, "azd", version, "en");
+
+            // Default resource/scope is irrelevant because azd always specifies the scope, however
+            // OneAuth doesn't accept "". Also, OneAuth appends "/.default" to scopes.
+            auto aadConfig = std::make_optional<AadConfiguration>(
+                UUID::FromString(clientID),
+                "http://localhost",               // redirectUri
+                "https://management.azure.com/"); // defaultSignInResource
+
+            auto authnConfig = AuthenticatorConfiguration(appConfig, aadConfig, std::nullopt, std::nullopt, std::nullopt);
+            if (auto error = OneAuth::Startup(authnConfig))
+            {
+                return error->ToString();
+            }
+            return "";
+        }
+
+        // Shutdown must run on the thread that called Startup, so it can uninitialize that thread's OLE after OneAuth
+        // shuts down
+        void Shutdown() override
+        {
+            OneAuth::Shutdown();
+            threadOle().Uninitialize();
+        }
+
+        void SetLogging(int level, BackendLogCallback callback) override
+        {
+            logCallback.store(callback);
+            OneAuth::SetLogCallback(log);
+            OneAuth::SetLogLevel(static_cast<LogLevel>(level + 1));
+        }
+
+        std::string NewCorrelationID() override
+        {
+            return UUID::Generate().ToString();
+        }
+
+        std::shared_ptr<BackendAccount> ReadAccount(const std::string &accountID, const std::string &correlationID) override
+        {
+            auto account = OneAuth::GetAuthenticator()->ReadAccountById(accountID, telemetry(correlationID));
+            if (!account)
+            {
+                return nullptr;
+            }
+            auto result = std::make_shared<OneAuthAccount>();
+            result->id = account->GetId();
+            result->account = account;
+            return result;
+        }
+
+        void AcquireTokenSilently(const BackendAccount &account, const std::string &authority, const std::string &scope, const std::string &correlationID, Callback callback) override
+        {
+            auto authParams = AuthParameters::CreateForBearer(authority, scope);
+            auto &a = static_cast<const OneAuthAccount &>(account);
+            OneAuth::GetAuthenticator()->AcquireCredentialSilently(*a.account, authParams, telemetry(correlationID), adapt(std::move(callback)));
+        }
+
+        void SignInInteractively(const std::string &authority, const std::string &scope, const std::string &correlationID, Callback callback) override
+        {
+            // the caller pumps messages for the login window on this thread
+            if (!threadOle().Initialize())
+            {
+                TokenResult result;
+                result.error = "OleInitialize failed";
+                callback(std::move(result));
+                return;
+            }
+            auto authParams = AuthParameters::CreateForBearer(authority, scope);
+            OneAuth::GetAuthenticator()->SignInInteractively(
+                OneAuth::DefaultUxContext,
+                "", // accountHint
+                authParams,
+                std::nullopt,
+                telemetry(correlationID),
+                adapt(std::move(callback)));
+        }
+
+        void SignInSilently(const std::string &correlationID, Callback callback) override
+        {
+            OneAuth::GetAuthenticator()->SignInSilently(std::nullopt, telemetry(correlationID), adapt(std::move(callback)));
+        }
+
+        void SignOut() override
+        {
+            auto telemetryParams = TelemetryParameters(UUID::Generate());
+            for (auto a : OneAuth::GetAuthenticator()->ReadAssociatedAccounts(telemetryParams))
+            {
+                // SignOut* delete data based on client ID i.e. they would sign the account
+                // out from az as well so long as azd and az share a client ID. Dis/associate
+                // use application ID e.g. "com.microsoft.azd" instead.
+                OneAuth::GetAuthenticator()->DisassociateAccount(a, telemetryParams, "");
+            }
+        }
+
+        std::shared_ptr<EventSource> NewEventSource() override
+        {
+            return std::make_shared<Win32EventSource>();
+        }
+    };
+}
+
+std::unique_ptr<Backend> NewBackend()
+{
+    return std::make_unique<OneAuthBackend>();
+}
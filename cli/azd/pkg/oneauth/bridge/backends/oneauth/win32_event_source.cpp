@@ -0,0 +1,57 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "win32_event_source.h"
+#include <algorithm>
+
+Win32EventSource::Win32EventSource() : signal(CreateEvent(nullptr, FALSE, FALSE, nullptr))
+{
+}
+
+Win32EventSource::~Win32EventSource()
+{
+    if (signal)
+    {
+        CloseHandle(signal);
+    }
+}
+
+PumpEvent Win32EventSource::Wait(std::chrono::milliseconds timeout)
+{
+    // INFINITE is the largest DWORD, so clamp just below it
+    auto ms = static_cast<DWORD>(std::clamp<int64_t>(timeout.count(), 0, INFINITE - 1));
+    // MWMO_INPUTAVAILABLE makes the wait return for messages already in the queue, not only new ones
+    DWORD count = signal ? 1 : 0;
+    auto result = MsgWaitForMultipleObjectsEx(count, &signal, ms, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+    if (result == WAIT_OBJECT_0 + count)
+    {
+        return PumpEvent::Message;
+    }
+    if (count && result == WAIT_OBJECT_0)
+    {
+        return PumpEvent::Signaled;
+    }
+    if (result == WAIT_FAILED)
+    {
+        return PumpEvent::Failed;
+    }
+    return PumpEvent::Timeout;
+}
+
+void Win32EventSource::Dispatch()
+{
+    MSG msg;
+    while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+    {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+    }
+}
+
+void Win32EventSource::Signal()
+{
+    if (signal)
+    {
+        SetEvent(signal);
+    }
+}
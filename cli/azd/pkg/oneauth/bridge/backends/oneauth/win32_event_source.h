@@ -0,0 +1,26 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "pump.h"
+#include <windows.h>
+
+// Win32EventSource is an EventSource for the message queue of the thread that created it. Only that thread
+// should call Wait and Dispatch.
+class Win32EventSource : public EventSource
+{
+public:
+    Win32EventSource();
+    ~Win32EventSource() override;
+    Win32EventSource(const Win32EventSource &) = delete;
+    Win32EventSource &operator=(const Win32EventSource &) = delete;
+
+    PumpEvent Wait(std::chrono::milliseconds timeout) override;
+    void Dispatch() override;
+    void Signal() override;
+
+private:
+    // signal is an auto-reset event, so each Signal wakes one Wait
+    HANDLE signal;
+};
@@ -0,0 +1,104 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "backend_trace.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    // magic identifies a trace file and the version of its format
+    const char magic[8] = {'A', 'Z', 'D', 'O', 'A', 'B', 'T', '1'};
+
+    void putLE(uint8_t *p, uint64_t v, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            p[i] = static_cast<uint8_t>(v >> (8 * i));
+        }
+    }
+
+    uint64_t getLE(const uint8_t *p, size_t size)
+    {
+        uint64_t v = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            v |= static_cast<uint64_t>(p[i]) << (8 * i);
+        }
+        return v;
+    }
+
+    void encode(const BackendTraceRecord &r, uint8_t *p)
+    {
+        p[0] = static_cast<uint8_t>(r.operation);
+        p[1] = static_cast<uint8_t>(r.result);
+        putLE(p + 2, r.callbackThread, 2);
+        putLE(p + 4, r.argumentsHash, 4);
+        putLE(p + 8, r.latencyMicroseconds, 4);
+        putLE(p + 12, r.lifetimeSeconds, 4);
+        putLE(p + 16, r.startMicroseconds, 8);
+    }
+
+    BackendTraceRecord decode(const uint8_t *p)
+    {
+        BackendTraceRecord r;
+        r.operation = static_cast<BackendOperation>(p[0]);
+        r.result = static_cast<BackendResultClass>(p[1]);
+        r.callbackThread = static_cast<uint16_t>(getLE(p + 2, 2));
+        r.argumentsHash = static_cast<uint32_t>(getLE(p + 4, 4));
+        r.latencyMicroseconds = static_cast<uint32_t>(getLE(p + 8, 4));
+        r.lifetimeSeconds = static_cast<uint32_t>(getLE(p + 12, 4));
+        r.startMicroseconds = getLE(p + 16, 8);
+        return r;
+    }
+}
+
+uint32_t hashArguments(std::initializer_list<std::string> arguments)
+{
+    uint32_t hash = 2166136261u;
+    for (const auto &argument : arguments)
+    {
+        for (auto c : argument)
+        {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+        // separate arguments so ("ab", "c") and ("a", "bc") hash differently
+        hash = (hash ^ 0xff) * 16777619u;
+    }
+    return hash;
+}
+
+bool WriteBackendTrace(const std::string &path, const std::vector<BackendTraceRecord> &records)
+{
+    auto f = fopen(path.c_str(), "wb");
+    if (!f)
+    {
+        return false;
+    }
+    auto ok = fwrite(magic, sizeof(magic), 1, f) == 1;
+    uint8_t buf[backendTraceRecordSize];
+    for (size_t i = 0; ok && i < records.size(); i++)
+    {
+        encode(records[i], buf);
+        ok = fwrite(buf, sizeof(buf), 1, f) == 1;
+    }
+    return fclose(f) == 0 && ok;
+}
+
+bool ReadBackendTrace(const std::string &path, std::vector<BackendTraceRecord> *records)
+{
+    auto f = fopen(path.c_str(), "rb");
+    if (!f)
+    {
+        return false;
+    }
+    char header[sizeof(magic)];
+    auto ok = fread(header, sizeof(header), 1, f) == 1 && memcmp(header, magic, sizeof(magic)) == 0;
+    uint8_t buf[backendTraceRecordSize];
+    while (ok && fread(buf, sizeof(buf), 1, f) == 1)
+    {
+        records->push_back(decode(buf));
+    }
+    fclose(f);
+    return ok;
+}
@@ -0,0 +1,67 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// A backend trace file records a session's backend calls so a ReplayBackend can reproduce their timing. It's
+// an 8-byte magic number followed by BackendTraceRecords in the order the calls completed. Each record is
+// backendTraceRecordSize bytes: its fields in declaration order, without padding, and integers little-endian,
+// regardless of the host. Traces don't contain tokens, account IDs or other arguments, only hashes of them.
+
+enum class BackendOperation : uint8_t
+{
+    Startup = 1,
+    ReadAccount,
+    AcquireTokenSilently,
+    SignInInteractively,
+    SignInSilently,
+    SignOut,
+};
+
+// BackendResultClass is the outcome of a backend call
+enum class BackendResultClass : uint8_t
+{
+    Success = 1,
+    Error,
+    // NotFound means ReadAccount found no account
+    NotFound,
+    // Dropped means the backend never called back
+    Dropped,
+};
+
+struct BackendTraceRecord
+{
+    BackendOperation operation;
+    BackendResultClass result;
+    // callbackThread is 0 when the backend called back on the calling thread, otherwise a number identifying
+    // the thread it called back on
+    uint16_t callbackThread;
+    // argumentsHash identifies the call's arguments, excluding correlation IDs
+    uint32_t argumentsHash;
+    // latencyMicroseconds is the time from the call to its return or callback
+    uint32_t latencyMicroseconds;
+    // lifetimeSeconds is the lifetime of the token a successful call returned
+    uint32_t lifetimeSeconds;
+    // startMicroseconds is when the call began, relative to the start of recording
+    uint64_t startMicroseconds;
+};
+
+// backendTraceRecordSize is the size of a record in a trace file
+const size_t backendTraceRecordSize = 24;
+
+// hashArguments returns the FNV-1a hash of the given strings
+uint32_t hashArguments(std::initializer_list<std::string> arguments);
+
+// WriteBackendTrace writes records to a trace file at path, replacing its content. It returns false when it
+// can't write the file.
+bool WriteBackendTrace(const std::string &path, const std::vector<BackendTraceRecord> &records);
+
+// ReadBackendTrace reads the records of the trace file at path. It returns false when it can't read the file
+// or the file isn't a trace.
+bool ReadBackendTrace(const std::string &path, std::vector<BackendTraceRecord> *records);
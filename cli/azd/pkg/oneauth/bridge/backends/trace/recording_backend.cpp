@@ -0,0 +1,182 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "recording_backend.h"
+#include "backend_trace.h"
+#include "clock.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    // threadNumber returns a small, nonzero number identifying the calling thread
+    uint16_t threadNumber()
+    {
+        static std::atomic<uint16_t> next{1};
+        thread_local uint16_t number = next.fetch_add(1);
+        return number;
+    }
+
+    uint32_t saturate(int64_t n)
+    {
+        return static_cast<uint32_t>(std::clamp<int64_t>(n, 0, UINT32_MAX));
+    }
+
+    class RecordingBackend : public Backend
+    {
+    public:
+        RecordingBackend(std::unique_ptr<Backend> inner, std::string path) : inner(std::move(inner)), path(std::move(path)) {}
+
+        std::string Startup(const std::string &clientID, const std::string &applicationID, const std::string &version) override
+        {
+            {
+                std::lock_guard<std::mutex> lock(mu);
+                origin = std::chrono::steady_clock::now();
+            }
+            auto start = std::chrono::steady_clock::now();
+            auto error = inner->Startup(clientID, applicationID, version);
+            add(BackendOperation::Startup, hashArguments({clientID, applicationID, version}), start, error.empty() ? BackendResultClass::Success : BackendResultClass::Error);
+            return error;
+        }
+
+        void Shutdown() override
+        {
+            inner->Shutdown();
+            std::vector<BackendTraceRecord> trace;
+            {
+                std::lock_guard<std::mutex> lock(mu);
+                for (auto &[id, record] : outstanding)
+                {
+                    record.result = BackendResultClass::Dropped;
+                    records.push_back(record);
+                }
+                outstanding.clear();
+                trace.swap(records);
+            }
+            WriteBackendTrace(path, trace);
+        }
+
+        void SetLogging(int level, BackendLogCallback callback) override
+        {
+            inner->SetLogging(level, callback);
+        }
+
+        std::string NewCorrelationID() override
+        {
+            return inner->NewCorrelationID();
+        }
+
+        std::shared_ptr<BackendAccount> ReadAccount(const std::string &accountID, const std::string &correlationID) override
+        {
+            auto start = std::chrono::steady_clock::now();
+            auto account = inner->ReadAccount(accountID, correlationID);
+            add(BackendOperation::ReadAccount, hashArguments({accountID}), start, account ? BackendResultClass::Success : BackendResultClass::NotFound);
+            return account;
+        }
+
+        void AcquireTokenSilently(const BackendAccount &account, const std::string &authority, const std::string &scope, const std::string &correlationID, Callback callback) override
+        {
+            auto hash = hashArguments({account.id, authority, scope});
+            inner->AcquireTokenSilently(account, authority, scope, correlationID, record(BackendOperation::AcquireTokenSilently, hash, std::move(callback)));
+        }
+
+        void SignInInteractively(const std::string &authority, const std::string &scope, const std::string &correlationID, Callback callback) override
+        {
+            auto hash = hashArguments({authority, scope});
+            inner->SignInInteractively(authority, scope, correlationID, record(BackendOperation::SignInInteractively, hash, std::move(callback)));
+        }
+
+        void SignInSilently(const std::string &correlationID, Callback callback) override
+        {
+            inner->SignInSilently(correlationID, record(BackendOperation::SignInSilently, hashArguments({}), std::move(callback)));
+        }
+
+        void SignOut() override
+        {
+            auto start = std::chrono::steady_clock::now();
+            inner->SignOut();
+            add(BackendOperation::SignOut, hashArguments({}), start, BackendResultClass::Success);
+        }
+
+        std::shared_ptr<EventSource> NewEventSource() override
+        {
+            return inner->NewEventSource();
+        }
+
+    private:
+        BackendTraceRecord newRecord(BackendOperation operation, uint32_t hash, std::chrono::steady_clock::time_point start)
+        {
+            BackendTraceRecord r{};
+            r.operation = operation;
+            r.argumentsHash = hash;
+            r.startMicroseconds = static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(start - origin).count()));
+            return r;
+        }
+
+        // add records a call that returned its result
+        void add(BackendOperation operation, uint32_t hash, std::chrono::steady_clock::time_point start, BackendResultClass result)
+        {
+            auto latency = std::chrono::steady_clock::now() - start;
+            std::lock_guard<std::mutex> lock(mu);
+            auto r = newRecord(operation, hash, start);
+            r.result = result;
+            r.latencyMicroseconds = saturate(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+            records.push_back(r);
+        }
+
+        // record returns a callback that records the call's result and then calls callback
+        Callback record(BackendOperation operation, uint32_t hash, Callback callback)
+        {
+            auto start = std::chrono::steady_clock::now();
+            uint64_t id;
+            {
+                std::lock_guard<std::mutex> lock(mu);
+                id = nextID++;
+                outstanding[id] = newRecord(operation, hash, start);
+            }
+            return [this, id, start, caller = std::this_thread::get_id(), callback = std::move(callback)](TokenResult result)
+            {
+                auto latency = std::chrono::steady_clock::now() - start;
+                {
+                    std::lock_guard<std::mutex> lock(mu);
+                    auto it = outstanding.find(id);
+                    // the call is missing when Shutdown recorded it as dropped
+                    if (it != outstanding.end())
+                    {
+                        auto r = it->second;
+                        outstanding.erase(it);
+                        r.result = result.error.empty() ? BackendResultClass::Success : BackendResultClass::Error;
+                        r.callbackThread = std::this_thread::get_id() == caller ? 0 : threadNumber();
+                        r.latencyMicroseconds = saturate(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+                        if (r.result == BackendResultClass::Success)
+                        {
+                            auto lifetime = result.expiresOn - GetClock().SystemNow();
+                            r.lifetimeSeconds = saturate(std::chrono::duration_cast<std::chrono::seconds>(lifetime).count());
+                        }
+                        records.push_back(r);
+                    }
+                }
+                callback(std::move(result));
+            };
+        }
+
+        std::unique_ptr<Backend> inner;
+        std::string path;
+        std::mutex mu;
+        std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+        uint64_t nextID = 1;
+        // outstanding are calls awaiting a callback
+        std::unordered_map<uint64_t, BackendTraceRecord> outstanding;
+        std::vector<BackendTraceRecord> records;
+    };
+}
+
+std::unique_ptr<Backend> NewRecordingBackend(std::unique_ptr<Backend> inner, const std::string &path)
+{
+    return std::make_unique<RecordingBackend>(std::move(inner), path);
+}
@@ -0,0 +1,12 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "backend.h"
+#include <memory>
+#include <string>
+
+// NewRecordingBackend returns a Backend that forwards calls to inner and records them in a trace file at path,
+// which it writes on Shutdown. Calls inner hasn't called back by then are recorded as dropped.
+std::unique_ptr<Backend> NewRecordingBackend(std::unique_ptr<Backend> inner, const std::string &path);
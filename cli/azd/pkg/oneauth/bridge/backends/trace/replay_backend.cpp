@@ -0,0 +1,212 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "replay_backend.h"
+#include "backend_trace.h"
+#include "clock.h"
+#include "fake_correlation_id.h"
+#include "fake_event_source.h"
+#include "scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+
+namespace
+{
+    const char *replayedAccountID = "replayed-account";
+
+    const char *operationName(BackendOperation operation)
+    {
+        switch (operation)
+        {
+        case BackendOperation::Startup:
+            return "Startup";
+        case BackendOperation::ReadAccount:
+            return "ReadAccount";
+        case BackendOperation::AcquireTokenSilently:
+            return "AcquireTokenSilently";
+        case BackendOperation::SignInInteractively:
+            return "SignInInteractively";
+        case BackendOperation::SignInSilently:
+            return "SignInSilently";
+        case BackendOperation::SignOut:
+            return "SignOut";
+        }
+        return "unknown operation";
+    }
+
+    class ReplayBackend : public Backend
+    {
+    public:
+        ReplayBackend(const std::string &path) : path(path)
+        {
+            std::vector<BackendTraceRecord> trace;
+            loaded = ReadBackendTrace(path, &trace);
+            // replay calls in the order they began, which is the order the bridge will make them
+            std::stable_sort(trace.begin(), trace.end(), [](const BackendTraceRecord &a, const BackendTraceRecord &b)
+                             { return a.startMicroseconds < b.startMicroseconds; });
+            for (auto &r : trace)
+            {
+                records[r.operation].push_back(r);
+            }
+        }
+
+        std::string Startup(const std::string &clientID, const std::string &applicationID, const std::string &version) override
+        {
+            if (!loaded)
+            {
+                return "couldn't read backend trace " + path;
+            }
+            BackendTraceRecord r;
+            if (next(BackendOperation::Startup, hashArguments({clientID, applicationID, version}), &r))
+            {
+                block(r);
+                if (r.result != BackendResultClass::Success)
+                {
+                    return "replayed Startup failure";
+                }
+            }
+            // a trace recorded after Startup has no Startup record, which doesn't prevent replaying the rest
+            return "";
+        }
+
+        void Shutdown() override
+        {
+            scheduler.Stop();
+        }
+
+        void SetLogging(int, BackendLogCallback) override {}
+
+        std::string NewCorrelationID() override
+        {
+            return FakeCorrelationID(++correlationIDs);
+        }
+
+        std::shared_ptr<BackendAccount> ReadAccount(const std::string &accountID, const std::string &) override
+        {
+            BackendTraceRecord r;
+            if (!next(BackendOperation::ReadAccount, hashArguments({accountID}), &r))
+            {
+                return nullptr;
+            }
+            block(r);
+            if (r.result != BackendResultClass::Success)
+            {
+                return nullptr;
+            }
+            auto account = std::make_shared<BackendAccount>();
+            account->id = accountID;
+            return account;
+        }
+
+        void AcquireTokenSilently(const BackendAccount &account, const std::string &authority, const std::string &scope, const std::string &, Callback callback) override
+        {
+            complete(BackendOperation::AcquireTokenSilently, hashArguments({account.id, authority, scope}), account.id, std::move(callback));
+        }
+
+        void SignInInteractively(const std::string &authority, const std::string &scope, const std::string &, Callback callback) override
+        {
+            complete(BackendOperation::SignInInteractively, hashArguments({authority, scope}), replayedAccountID, std::move(callback));
+        }
+
+        void SignInSilently(const std::string &, Callback callback) override
+        {
+            complete(BackendOperation::SignInSilently, hashArguments({}), replayedAccountID, std::move(callback));
+        }
+
+        void SignOut() override
+        {
+            BackendTraceRecord r;
+            if (next(BackendOperation::SignOut, hashArguments({}), &r))
+            {
+                block(r);
+            }
+        }
+
+        std::shared_ptr<EventSource> NewEventSource() override
+        {
+            return std::make_shared<FakeEventSource>();
+        }
+
+    private:
+        // next consumes the next record of operation, preferring one having the given arguments hash. It returns
+        // false when no record of operation remains.
+        bool next(BackendOperation operation, uint32_t hash, BackendTraceRecord *r)
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            auto &pending = records[operation];
+            if (pending.empty())
+            {
+                return false;
+            }
+            auto it = std::find_if(pending.begin(), pending.end(), [hash](const BackendTraceRecord &p)
+                                   { return p.argumentsHash == hash; });
+            if (it == pending.end())
+            {
+                it = pending.begin();
+            }
+            *r = *it;
+            pending.erase(it);
+            return true;
+        }
+
+        // block replays the latency of a call that returned its result
+        void block(const BackendTraceRecord &r)
+        {
+            if (r.latencyMicroseconds > 0)
+            {
+                SleepFor(GetClock(), std::chrono::microseconds(r.latencyMicroseconds));
+            }
+        }
+
+        // complete calls callback as the next record of operation specifies
+        void complete(BackendOperation operation, uint32_t hash, const std::string &accountID, Callback callback)
+        {
+            TokenResult result;
+            BackendTraceRecord r;
+            if (!next(operation, hash, &r))
+            {
+                result.error = std::string("backend trace has no ") + operationName(operation) + " call to replay";
+                callback(std::move(result));
+                return;
+            }
+            if (r.result == BackendResultClass::Dropped)
+            {
+                return;
+            }
+            if (r.result == BackendResultClass::Success)
+            {
+                result.accountID = accountID;
+                result.expiresOn = std::chrono::time_point_cast<std::chrono::system_clock::duration>(GetClock().SystemNow() + std::chrono::seconds(r.lifetimeSeconds));
+                result.token = "replayed-token-" + std::to_string(++tokens);
+            }
+            else
+            {
+                result.error = std::string("replayed ") + operationName(operation) + " failure";
+            }
+            if (r.callbackThread == 0)
+            {
+                block(r);
+                callback(std::move(result));
+                return;
+            }
+            scheduler.After(std::chrono::microseconds(r.latencyMicroseconds), [callback = std::move(callback), result = std::move(result)]() mutable
+                            { callback(std::move(result)); });
+        }
+
+        std::string path;
+        bool loaded = false;
+        std::mutex mu;
+        std::map<BackendOperation, std::deque<BackendTraceRecord>> records;
+        std::atomic<uint64_t> correlationIDs{0};
+        std::atomic<uint64_t> tokens{0};
+        Scheduler scheduler;
+    };
+}
+
+std::unique_ptr<Backend> NewReplayBackend(const std::string &path)
+{
+    return std::make_unique<ReplayBackend>(path);
+}
@@ -0,0 +1,14 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "backend.h"
+#include <memory>
+#include <string>
+
+// NewReplayBackend returns a Backend that answers calls as the trace file at path recorded, after the recorded
+// latency and on the calling thread or another thread, as recorded. Each call consumes the next record of its
+// operation having the same arguments, or failing that the next record of its operation. Calls the trace has
+// no record for fail immediately. Tokens are fake but have the recorded lifetimes.
+std::unique_ptr<Backend> NewReplayBackend(const std::string &path);
@@ -0,0 +1,228 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+// bridge_bench measures the overhead of the bridge's exports against the fake backend, which completes every
+// operation immediately, so the results are the cost of the bridge itself. Build it with CMAKE_BUILD_TYPE=Release,
+// and run it with --benchmark_out=<file> --benchmark_out_format=json, or build the run_bridge_bench target, to
+// record results as JSON.
+
+#include "bridge.h"
+#include "fake_backend.h"
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+    const char *authority = "https://login.microsoftonline.com/organizations";
+    const char *scope = "https://management.azure.com//.default";
+    const char *accountID = "account";
+
+    // expirySkewSeconds is the token cache's default expiry skew
+    const int expirySkewSeconds = 300;
+
+    std::atomic<uint64_t> logged{0};
+
+    void countingLogger(const char *)
+    {
+        logged++;
+    }
+
+    void startup(Logger logger)
+    {
+        if (auto err = Startup("04b07795-8ddb-461a-bbee-02f9e1bf7b46", "com.microsoft.azd", "1.0.0", logger))
+        {
+            fprintf(stderr, "Startup failed: %s\n", err->message);
+            FreeWrappedError(err);
+            exit(1);
+        }
+    }
+
+    // prime caches a token for the benchmarks' authority, scope and account
+    void prime()
+    {
+        FreePackedAuthResult(AuthenticatePacked(authority, scope, accountID, false));
+    }
+
+    void disableTokenCache(const benchmark::State &)
+    {
+        ConfigureTokenCache(-1);
+    }
+
+    void enableTokenCache(const benchmark::State &)
+    {
+        ConfigureTokenCache(expirySkewSeconds);
+    }
+}
+
+// AuthenticateCacheHit is the common case of azd requesting a token it requested before
+void AuthenticateCacheHit(benchmark::State &state)
+{
+    prime();
+    for (auto _ : state)
+    {
+        FreeWrappedAuthResult(Authenticate(authority, scope, accountID, false));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(AuthenticateCacheHit)->ThreadRange(1, 16)->UseRealTime();
+
+void AuthenticatePackedCacheHit(benchmark::State &state)
+{
+    prime();
+    for (auto _ : state)
+    {
+        FreePackedAuthResult(AuthenticatePacked(authority, scope, accountID, false));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(AuthenticatePackedCacheHit)->ThreadRange(1, 16)->UseRealTime();
+
+// AuthenticateCacheMiss disables the token cache, so every call goes through the account cache, request
+// coalescing and a backend request
+void AuthenticateCacheMiss(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        FreeWrappedAuthResult(Authenticate(authority, scope, accountID, false));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(AuthenticateCacheMiss)->Setup(disableTokenCache)->Teardown(enableTokenCache)->ThreadRange(1, 16)->UseRealTime();
+
+// AuthenticateManyCacheHit requests a typical provisioning's set of tokens in one call
+void AuthenticateManyCacheHit(benchmark::State &state)
+{
+    TokenRequest requests[] = {
+        {authority, scope},
+        {authority, "https://vault.azure.net/.default"},
+        {authority, "https://storage.azure.com/.default"},
+        {authority, "https://graph.microsoft.com/.default"},
+    };
+    auto count = static_cast<int>(sizeof(requests) / sizeof(requests[0]));
+    FreeWrappedAuthResults(AuthenticateMany(requests, count, accountID), count);
+    for (auto _ : state)
+    {
+        FreeWrappedAuthResults(AuthenticateMany(requests, count, accountID), count);
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(AuthenticateManyCacheHit);
+
+// WrapAuthResult measures marshalling a result for Go and freeing it, by waiting for a completed request.
+// The argument is the token's length.
+void WrapAuthResult(benchmark::State &state)
+{
+    FakeBackendOptions options{};
+    options.tokenLength = static_cast<int32_t>(state.range(0));
+    ConfigureFakeBackend(&options);
+    ConfigureTokenCache(-1);
+    auto request = AuthenticateAsync(authority, scope, accountID, nullptr, 0);
+    for (auto _ : state)
+    {
+        FreeWrappedAuthResult(WaitAuthRequest(request, 0));
+    }
+    FreeAuthRequest(request);
+    ConfigureTokenCache(expirySkewSeconds);
+    ConfigureFakeBackend(nullptr);
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(WrapAuthResult)->Arg(16)->Arg(2048)->Arg(8192);
+
+// WrapAuthResultPacked is WrapAuthResult for PackedAuthResult
+void WrapAuthResultPacked(benchmark::State &state)
+{
+    FakeBackendOptions options{};
+    options.tokenLength = static_cast<int32_t>(state.range(0));
+    ConfigureFakeBackend(&options);
+    ConfigureTokenCache(-1);
+    auto request = AuthenticateAsync(authority, scope, accountID, nullptr, 0);
+    for (auto _ : state)
+    {
+        FreePackedAuthResult(WaitAuthRequestPacked(request, 0));
+    }
+    FreeAuthRequest(request);
+    ConfigureTokenCache(expirySkewSeconds);
+    ConfigureFakeBackend(nullptr);
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(WrapAuthResultPacked)->Arg(16)->Arg(2048)->Arg(8192);
+
+// logMode selects where LogCallback's messages go
+enum logMode
+{
+    logToCallback,
+    logToRing,
+    logFiltered,
+};
+
+// LogCallback measures the bridge's handling of a backend log message. Buffered messages are drained as Go
+// would drain them, so the ring doesn't fill.
+void LogCallback(benchmark::State &state)
+{
+    auto mode = static_cast<logMode>(state.range(0));
+    Shutdown();
+    startup(mode == logToCallback ? countingLogger : nullptr);
+    SetLogOptions(mode == logFiltered ? 2 : 3, 0);
+
+    LogRecord records[64];
+    uint64_t n = 0;
+    for (auto _ : state)
+    {
+        FakeBackendLog(3, "fake backend: a message of typical length for OneAuth's informational logging");
+        if (mode == logToRing && ++n % 64 == 0)
+        {
+            DrainLogs(records, 64, nullptr);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    SetLogOptions(3, 0);
+    Shutdown();
+    startup(nullptr);
+}
+BENCHMARK(LogCallback)->ArgName("mode")->Arg(logToCallback)->Arg(logToRing)->Arg(logFiltered);
+
+// LogCallbackContended measures buffering messages arriving on many threads, as OneAuth's do
+void LogCallbackContended(benchmark::State &state)
+{
+    LogRecord records[64];
+    uint64_t n = 0;
+    for (auto _ : state)
+    {
+        FakeBackendLog(3, "fake backend: a message of typical length for OneAuth's informational logging");
+        if (state.thread_index() == 0 && ++n % 16 == 0)
+        {
+            DrainLogs(records, 64, nullptr);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(LogCallbackContended)->ThreadRange(1, 16)->UseRealTime();
+
+void StartupShutdown(benchmark::State &state)
+{
+    Shutdown();
+    for (auto _ : state)
+    {
+        startup(nullptr);
+        Shutdown();
+    }
+    startup(nullptr);
+}
+BENCHMARK(StartupShutdown);
+
+int main(int argc, char **argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    startup(nullptr);
+    benchmark::RunSpecifiedBenchmarks();
+    Shutdown();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -2,190 +2,1004 @@
 // Licensed under the MIT License.
 
 #include "bridge.h"
-#include <future>
-#include <OneAuth/OneAuthWin.hpp>
-#include <windows.h>
-
-using namespace Microsoft::Authentication;
-using Microsoft::Authentication::UUID;
+#include "backend.h"
+#include "build_id.h"
+#include "cancellation.h"
+#include "clock.h"
+#include "log_ring.h"
+#include "lru_cache.h"
+#include "pending_auth.h"
+#include "persistent_token_cache.h"
+#include "pump.h"
+#include "rate_limiter.h"
+#include "recording_backend.h"
+#include "stats.h"
+#include "token_cache.h"
+#include "trace.h"
+#include "worker.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
 
 const int timeoutSeconds = 60;
+const char *interactionRequired = "Interactive authentication is required. Run 'azd auth login'";
+const char *cancelled = "authentication cancelled";
+const char *notCached = "no cached token";
+// defaultScope is the scope Warmup acquires when its caller doesn't specify one. It's OneAuth's default sign-in
+// resource, which is the scope of azd's first ARM request.
+const char *defaultScope = "https://management.azure.com/";
+
+// WaitOptions bound how long a synchronous authentication request waits
+struct WaitOptions
+{
+    // deadline is when the caller stops waiting. Without one, each phase of authentication waits
+    // at most timeoutSeconds.
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    // cancellationID, when nonzero, identifies the request to CancelAuthenticate
+    uint64_t cancellationID = 0;
+};
+
+// Timings are the durations of the phases of a synchronous authentication request. Like the bridge's other
+// measurements, they come from steady_clock rather than GetClock, so they report real time even when a test
+// simulates hours with a ManualClock.
+struct Timings
+{
+    std::chrono::steady_clock::duration accountLookup{};
+    std::chrono::steady_clock::duration silentWait{};
+    std::chrono::steady_clock::duration pump{};
+};
+
+// AuthRequest is the handle returned by the asynchronous exports
+struct AuthRequest
+{
+    std::shared_ptr<PendingAuth> pending;
+    uint64_t subscription;
+};
+
+// backend returns the authentication service behind the exports. When AZD_ONEAUTH_RECORD_FILE names a file, the
+// bridge records the service's calls to it on Shutdown.
+Backend &backend()
+{
+    static auto instance = []
+    {
+        auto b = NewBackend();
+        auto p = std::getenv("AZD_ONEAUTH_RECORD_FILE");
+        return p && *p ? NewRecordingBackend(std::move(b), p) : std::move(b);
+    }();
+    return *instance;
+}
+
+static TokenCache tokenCache;
+
+// persistentTokens shares tokens with other processes through the file OpenTokenCacheFile opens
+static PersistentTokenCache persistentTokens;
+
+// accounts caches accounts read from the backend. azd almost always authenticates the same account, so this
+// spares most calls a read of the broker's account store.
+static LruCache<BackendAccount> accounts{8};
+
+// cancellations tracks synchronous requests callers may cancel
+static Cancellations cancellations;
+
+// inflight coalesces concurrent silent acquisitions of the same token
+static InflightRequests inflight{std::chrono::seconds(timeoutSeconds)};
+
+// worker refreshes cached tokens in the background
+static Worker worker;
+
+// counters are the performance counters GetBridgeStats reports
+static Stats counters;
+
+// logs buffers log messages when Startup's caller doesn't provide a callback, so the backend's logging
+// threads needn't call into the caller
+static LogRing logs{512};
+
+// logLevel is the most verbose level the bridge logs, as for SetLogOptions
+static std::atomic<int> logLevel{3};
+static RateLimiter logLimiter;
 
 static std::function<void(const char *)> globalLogCallback;
-void logCallback(LogLevel level, const char *message, int identifiableInformation)
+void logCallback(int level, const char *message, bool identifiable)
 {
-    if (!identifiableInformation && globalLogCallback)
+    if (identifiable || !message || level > logLevel.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    if (!logLimiter.Allow())
+    {
+        logs.Drop();
+        return;
+    }
+    if (globalLogCallback)
     {
         globalLogCallback(message);
     }
+    else
+    {
+        logs.Push(message, strlen(message));
+    }
 }
 
-WrappedError *Startup(const char *clientId, const char *applicationId, const char *version, Logger logger)
+// str converts a string from Go, which may be NULL
+std::string str(const char *s)
 {
-    HRESULT OleInitResult = OleInitialize(NULL);
-    if (OleInitResult != S_OK && OleInitResult != S_FALSE)
-    {
-        auto err = new WrappedError();
-        err->message = strdup("OleInitialize failed");
-        return err;
-    }
+    return s ? s : "";
+}
+
+// startupRequest is the startup StartupAsync began, if any. starting is true from then until the startup succeeds,
+// and remains true after a failure, so exports needing the backend report the failure.
+static std::mutex startupMu;
+static std::shared_ptr<PendingAuth> startupRequest;
+static std::atomic<bool> starting{false};
 
+// startup implements Startup and StartupAsync. It returns an error message when the backend fails to start.
+std::string startup(const std::string &clientId, const std::string &applicationId, const std::string &version, Logger logger)
+{
+    TraceSpan span("Startup");
+    Stopwatch stopwatch(counters.startup);
     globalLogCallback = logger;
-    OneAuth::SetLogCallback(logCallback);
-    OneAuth::SetLogLevel(LogLevel::LogLevelInfo);
+    backend().SetLogging(logLevel.load(), logCallback);
+    return backend().Startup(clientId, applicationId, version);
+}
 
-    auto appConfig = AppConfiguration(applicationId, "azd", version, "en");
+// resetStartup forgets any startup StartupAsync began, completing it with an error if it's still pending
+void resetStartup()
+{
+    std::shared_ptr<PendingAuth> pending;
+    {
+        std::lock_guard<std::mutex> lock(startupMu);
+        pending.swap(startupRequest);
+        starting.store(false);
+    }
+    if (pending)
+    {
+        TokenResult result;
+        result.error = "the bridge shut down";
+        pending->Complete(std::move(result));
+    }
+}
 
-    // Default resource/scope is irrelevant because azd always specifies the scope, however
-    // OneAuth doesn't accept "". Also, OneAuth appends "/.default" to scopes.
-    auto aadConfig = std::make_optional<AadConfiguration>(
-        UUID::FromString(clientId),
-        "http://localhost",               // redirectUri
-        "https://management.azure.com/"); // defaultSignInResource
+// awaitStartup waits for a startup StartupAsync began. It returns an error message when that startup failed or
+// didn't finish in time, and returns immediately when no startup is in progress.
+std::string awaitStartup()
+{
+    if (!starting.load())
+    {
+        return "";
+    }
+    std::shared_ptr<PendingAuth> pending;
+    {
+        std::lock_guard<std::mutex> lock(startupMu);
+        pending = startupRequest;
+    }
+    if (!pending)
+    {
+        return "";
+    }
+    auto result = pending->Wait(std::chrono::seconds(timeoutSeconds));
+    if (!result)
+    {
+        counters.timeouts++;
+        return "timed out waiting for OneAuth to start";
+    }
+    return result->error;
+}
 
-    auto authnConfig = AuthenticatorConfiguration(appConfig, aadConfig, std::nullopt, std::nullopt, std::nullopt);
-    if (auto error = OneAuth::Startup(authnConfig))
+WrappedError *Startup(const char *clientId, const char *applicationId, const char *version, Logger logger)
+{
+    tracer.Enable();
+    resetStartup();
+    auto error = startup(str(clientId), str(applicationId), str(version), logger);
+    if (!error.empty())
     {
         auto wrapped = new WrappedError();
-        wrapped->message = strdup(error->ToString().c_str());
+        wrapped->message = strdup(error.c_str());
         return wrapped;
     }
 
+    worker.Start();
+
     return nullptr;
 }
 
+// startedAsync returns true when StartupAsync began the current startup
+bool startedAsync()
+{
+    std::lock_guard<std::mutex> lock(startupMu);
+    return startupRequest != nullptr;
+}
+
 void Shutdown()
 {
-    OneAuth::Shutdown();
-    OleUninitialize();
+    {
+        TraceSpan span("Shutdown");
+        // the backend shuts down on the thread that started it, so after StartupAsync it shuts down on the worker's
+        // thread, after any startup in progress and before that thread exits
+        auto shutDown = startedAsync() && worker.Run([]
+                                                     { backend().Shutdown(); });
+        worker.Stop();
+        resetStartup();
+        accounts.Clear();
+        tokenCache.Clear();
+        if (!shutDown)
+        {
+            backend().Shutdown();
+        }
+    }
+    tracer.Flush();
 }
 
-// wrapAuthResult copies the data from a OneAuth AuthResult into a new struct that can be returned to
-// Go. An AuthResult itself can't be returned to Go because it contains shared_ptrs that may be freed
-// before Go is done with them. This workaround makes the Go application responsible for calling
-// FreeWrappedAuthResult to free memory allocated here.
-WrappedAuthResult *wrapAuthResult(const AuthResult *ar)
+TokenResult fromCachedToken(const CachedToken &token)
 {
-    auto wrapped = new WrappedAuthResult();
-    if (auto account = ar->GetAccount())
+    return TokenResult{token.accountID, "", token.expiresOn, token.token, ""};
+}
+
+TokenResult errorResult(const char *message)
+{
+    TokenResult result;
+    result.error = message;
+    return result;
+}
+
+// fillWrappedAuthResult copies a TokenResult into a WrappedAuthResult that can be returned to Go. This makes
+// the Go application responsible for calling FreeWrappedAuthResult to free memory allocated here.
+void fillWrappedAuthResult(WrappedAuthResult *wrapped, const TokenResult &result)
+{
+    if (!result.accountID.empty())
     {
-        wrapped->accountID = strdup(account->GetId().c_str());
+        wrapped->accountID = strdup(result.accountID.c_str());
     }
-    if (auto credential = ar->GetCredential())
+    if (!result.token.empty())
     {
-        auto duration = credential->GetExpiresOn().time_since_epoch();
+        auto duration = result.expiresOn.time_since_epoch();
         wrapped->expiresOn = std::chrono::duration_cast<std::chrono::seconds>(duration).count();
-        wrapped->token = strdup(credential->GetValue().c_str());
+        wrapped->token = strdup(result.token.c_str());
     }
-    if (auto error = ar->GetError())
+    if (!result.error.empty())
     {
-        auto err = error->ToString();
-        wrapped->errorDescription = strdup(err.c_str());
+        wrapped->errorDescription = strdup(result.error.c_str());
     }
+}
+
+WrappedAuthResult *wrapAuthResult(const TokenResult &result)
+{
+    auto wrapped = new WrappedAuthResult();
+    fillWrappedAuthResult(wrapped, result);
     return wrapped;
 }
 
-WrappedAuthResult *Authenticate(const char *authority, const char *scope, const char *accountID, bool allowPrompt)
+// microseconds converts a duration for a PackedAuthResult, saturating rather than overflowing
+uint32_t microseconds(std::chrono::steady_clock::duration d)
 {
-    auto authParams = AuthParameters::CreateForBearer(authority, scope);
-    auto telemetryParams = TelemetryParameters(UUID::Generate());
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    return static_cast<uint32_t>(std::clamp<int64_t>(us, 0, UINT32_MAX));
+}
 
-    std::promise<AuthResult> promise;
-    std::future<AuthResult> future = promise.get_future();
-    auto callback = [&promise](const AuthResult &result)
+// packAuthResult copies a result into a single allocation that can be returned to Go, which is responsible
+// for calling FreePackedAuthResult to free it. The strings follow the struct in the order accountID, token,
+// error, correlationID, each NUL-terminated so C code can use them directly.
+PackedAuthResult *packAuthResult(const std::string &accountID, const std::string &token, std::chrono::system_clock::time_point expiresOn, const std::string &error, const std::string &correlationID = "", const Timings &timings = Timings())
+{
+    auto start = std::chrono::steady_clock::now();
+    auto packed = static_cast<PackedAuthResult *>(malloc(sizeof(PackedAuthResult) + accountID.size() + token.size() + error.size() + correlationID.size() + 4));
+    if (!packed)
     {
-        promise.set_value(result);
+        return nullptr;
+    }
+    auto data = reinterpret_cast<char *>(packed + 1);
+    auto copy = [&data](const std::string &s, const char **field, uint32_t *length)
+    {
+        memcpy(data, s.c_str(), s.size() + 1);
+        *field = s.empty() ? nullptr : data;
+        *length = static_cast<uint32_t>(s.size());
+        data += s.size() + 1;
     };
+    copy(accountID, &packed->accountID, &packed->accountIDLength);
+    copy(token, &packed->token, &packed->tokenLength);
+    copy(error, &packed->error, &packed->errorLength);
+    copy(correlationID, &packed->correlationID, &packed->correlationIDLength);
+    packed->expiresOn = token.empty() ? 0 : std::chrono::duration_cast<std::chrono::seconds>(expiresOn.time_since_epoch()).count();
+    packed->accountLookupMicroseconds = microseconds(timings.accountLookup);
+    packed->silentWaitMicroseconds = microseconds(timings.silentWait);
+    packed->pumpMicroseconds = microseconds(timings.pump);
+    packed->marshalMicroseconds = microseconds(std::chrono::steady_clock::now() - start);
+    return packed;
+}
+
+PackedAuthResult *packAuthResult(const TokenResult &result, const Timings &timings = Timings())
+{
+    return packAuthResult(result.accountID, result.token, result.expiresOn, result.error, result.correlationID, timings);
+}
 
-    if (accountID && strlen(accountID) > 0)
+// completer returns a backend callback that completes pending with the result of the backend request having
+// the given correlation ID. The callback traces the request as operation, from the call to completer, so
+// callers should call completer just before calling the backend. When authority and scope are given, the callback also
+// adds a successfully acquired token to the token cache. When latency is given, the callback records the
+// request's duration, measured on steady_clock, in it.
+Backend::Callback completer(std::shared_ptr<PendingAuth> pending, const std::string &correlationID, const char *operation, std::string authority = "", std::string scope = "", Histogram *latency = nullptr)
+{
+    auto start = std::chrono::steady_clock::now();
+    return [pending, id = correlationID, operation, authority, scope, latency, start](TokenResult result)
     {
-        if (auto account = OneAuth::GetAuthenticator()->ReadAccountById(accountID, telemetryParams))
+        if (latency)
+        {
+            latency->Since(start);
+        }
+        tracer.Record(operation, start, std::chrono::steady_clock::now(), id);
+        result.correlationID = id;
+        if (!result.error.empty())
         {
-            OneAuth::GetAuthenticator()->AcquireCredentialSilently(*account, authParams, telemetryParams, callback);
-            // impose a deadline because we don't want to hang should OneAuth not call the callback
-            future.wait_for(std::chrono::seconds(timeoutSeconds));
+            counters.errors++;
         }
+        if (!authority.empty() && result.error.empty())
+        {
+            CachedToken token{result.accountID, result.token, result.expiresOn};
+            tokenCache.Put(authority, scope, token);
+            persistentTokens.Put(authority, scope, token);
+        }
+        pending->Complete(std::move(result));
+    };
+}
+
+// completed returns a request that has already completed with the given result
+std::shared_ptr<PendingAuth> completed(TokenResult result)
+{
+    auto pending = std::make_shared<PendingAuth>();
+    pending->Complete(std::move(result));
+    return pending;
+}
+
+std::shared_ptr<BackendAccount> readAccount(const std::string &accountID)
+{
+    if (auto account = accounts.Get(accountID))
+    {
+        return account;
+    }
+    std::shared_ptr<BackendAccount> account;
+    {
+        TraceSpan span("ReadAccountById");
+        Stopwatch stopwatch(counters.readAccount);
+        account = backend().ReadAccount(accountID, backend().NewCorrelationID());
+    }
+    if (account)
+    {
+        accounts.Put(accountID, account);
     }
+    return account;
+}
 
-    // if the future isn't ready, we didn't find an account or silent auth failed or timed out
-    // (we don't care why silent auth failed because in any case we would fall back to interactive auth)
-    if (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+// acquireSilently returns a silent acquisition of a token for the given account. If an identical acquisition
+// is already in flight, it returns that one instead of starting another.
+std::shared_ptr<PendingAuth> acquireSilently(const BackendAccount &account, const std::string &authority, const std::string &scope)
+{
+    auto [pending, started] = inflight.Join(tokenKey(authority, scope, account.id));
+    if (started)
     {
-        if (!allowPrompt)
-        {
-            auto ar = new WrappedAuthResult();
-            ar->errorDescription = strdup("Interactive authentication is required. Run 'azd auth login'");
-            return ar;
-        }
+        auto correlationID = backend().NewCorrelationID();
+        backend().AcquireTokenSilently(account, authority, scope, correlationID, completer(pending, correlationID, "AcquireCredentialSilently", authority, scope, &counters.silentAcquisition));
+    }
+    return pending;
+}
 
-        OneAuth::GetAuthenticator()->SignInInteractively(
-            OneAuth::DefaultUxContext,
-            "", // accountHint
-            authParams,
-            std::nullopt,
-            telemetryParams,
-            callback);
+// acquireSilently returns a silent acquisition of a token for the account having the given ID, or nullptr
+// when the backend has no such account.
+std::shared_ptr<PendingAuth> acquireSilently(const std::string &authority, const std::string &scope, const std::string &accountID)
+{
+    // join an identical acquisition, if one is in flight, before spending time reading the account
+    if (auto pending = inflight.Find(tokenKey(authority, scope, accountID)))
+    {
+        return pending;
+    }
+    if (auto account = readAccount(accountID))
+    {
+        return acquireSilently(*account, authority, scope);
+    }
+    return nullptr;
+}
 
-        // Login window requires us to pump win32 messages. Check the future before starting the pump because
-        // SignInInteractively may call back with an error before displaying the login window, in which case
-        // GetMessage will never return because there will never be a message in the queue, because azd has no
-        // windows.
-        MSG msg;
-        auto ready = future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+// getPersistedToken returns a token from the token cache file, if it has one, adding that token to the in-memory
+// cache. Another process may have acquired the token.
+std::shared_ptr<const CachedToken> getPersistedToken(const std::string &authority, const std::string &scope, const std::string &accountID)
+{
+    auto persisted = persistentTokens.Get(authority, scope, accountID);
+    if (persisted)
+    {
+        tokenCache.Put(authority, scope, *persisted);
+    }
+    return persisted;
+}
+
+// getCachedToken returns a token from the cache, if it has one. When that token is within the refresh window,
+// getCachedToken also schedules a background refresh so that later calls get a new token.
+std::shared_ptr<const CachedToken> getCachedToken(const std::string &authority, const std::string &scope, const std::string &accountID)
+{
+    if (accountID.empty())
+    {
+        return nullptr;
+    }
+    auto refresh = false;
+    auto cached = tokenCache.Get(authority, scope, accountID, &refresh);
+    if (!cached && getPersistedToken(authority, scope, accountID))
+    {
+        // ask again so the in-memory cache decides whether to refresh the token
+        cached = tokenCache.Get(authority, scope, accountID, &refresh);
+    }
+    if (refresh)
+    {
+        worker.Post(
+            [authority, scope, accountID]()
+            {
+                // nothing waits for this request; its callback adds the new token to the cache
+                if (awaitStartup().empty())
+                {
+                    acquireSilently(authority, scope, accountID);
+                }
+            });
+    }
+    return cached;
+}
+
+// waitFor waits for pending to complete, returning nullopt when deadline passes or the caller cancels first
+std::optional<TokenResult> waitFor(const std::shared_ptr<PendingAuth> &pending, const std::shared_ptr<Waiter> &waiter, std::chrono::steady_clock::time_point deadline)
+{
+    auto subscription = pending->Subscribe([waiter]
+                                           { waiter->Wake(); });
+    waiter->WaitUntil(deadline, [&pending]
+                      { return pending->Done(); });
+    pending->Unsubscribe(subscription);
+    return pending->Wait(std::chrono::milliseconds(0));
+}
+
+// phaseDeadline returns the deadline for a phase of authentication starting now. Each phase has its own
+// timeout because we don't want to hang should the backend not call back, and the caller's deadline bounds all phases.
+std::chrono::steady_clock::time_point phaseDeadline(const WaitOptions &options)
+{
+    auto deadline = GetClock().Now() + std::chrono::seconds(timeoutSeconds);
+    return options.deadline ? std::min(deadline, *options.deadline) : deadline;
+}
+
+bool pastDeadline(const WaitOptions &options)
+{
+    return options.deadline && GetClock().Now() >= *options.deadline;
+}
+
+// authenticateWith implements authenticate, waiting with waiter
+TokenResult authenticateWith(const std::shared_ptr<Waiter> &waiter, const std::string &authority, const std::string &scope, const std::string &accountID, bool allowPrompt, const WaitOptions &options, Timings &timings)
+{
+    auto startupError = awaitStartup();
+    if (!startupError.empty())
+    {
+        return errorResult(startupError.c_str());
+    }
+    if (!accountID.empty())
+    {
         auto start = std::chrono::steady_clock::now();
-        auto timedOut = false;
-        while (!(ready || timedOut))
-        {
-            GetMessage(&msg, nullptr, 0, 0);
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
-            ready = future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
-            timedOut = std::chrono::steady_clock::now() - start >= std::chrono::seconds(timeoutSeconds);
-            if (ready || timedOut)
+        auto pending = acquireSilently(authority, scope, accountID);
+        timings.accountLookup = std::chrono::steady_clock::now() - start;
+        if (pending)
+        {
+            start = std::chrono::steady_clock::now();
+            auto result = waitFor(pending, waiter, phaseDeadline(options));
+            auto end = std::chrono::steady_clock::now();
+            timings.silentWait = end - start;
+            tracer.Record("silent wait", start, end);
+            if (result)
             {
-                PostQuitMessage(0);
+                return *result;
+            }
+            // the backend may still call back; that's safe because the callback shares ownership of pending
+            if (waiter->Cancelled())
+            {
+                return errorResult(cancelled);
+            }
+            counters.timeouts++;
+            if (pastDeadline(options))
+            {
+                return errorResult("timed out waiting for silent authentication");
             }
         }
-        if (timedOut)
+    }
+
+    // we didn't find an account or silent auth timed out
+    if (!allowPrompt)
+    {
+        return errorResult(interactionRequired);
+    }
+    if (waiter->Cancelled())
+    {
+        return errorResult(cancelled);
+    }
+
+    auto pending = std::make_shared<PendingAuth>();
+    auto correlationID = backend().NewCorrelationID();
+    backend().SignInInteractively(authority, scope, correlationID, completer(pending, correlationID, "SignInInteractively", authority, scope, &counters.interactiveSignIn));
+
+    // Login window requires us to pump window messages. The pump wakes for messages, completion, cancellation
+    // and the deadline, whichever comes first, because SignInInteractively may call back with an error before
+    // displaying the login window, in which case no message will ever arrive because azd has no windows.
+    auto source = backend().NewEventSource();
+    auto subscription = pending->Subscribe([source]
+                                           { source->Signal(); });
+    waiter->SetWaker([source]
+                     { source->Signal(); });
+    auto start = std::chrono::steady_clock::now();
+    auto finished = Pump(
+        *source, phaseDeadline(options), [&pending, &waiter]
+        { return pending->Done() || waiter->Cancelled(); },
+        &counters.pumpIterations);
+    auto end = std::chrono::steady_clock::now();
+    timings.pump = end - start;
+    tracer.Record("message pump", start, end);
+    waiter->SetWaker(nullptr);
+    pending->Unsubscribe(subscription);
+    if (auto result = pending->Wait(std::chrono::milliseconds(0)))
+    {
+        return *result;
+    }
+    if (finished == PumpResult::Done)
+    {
+        return errorResult(cancelled);
+    }
+    if (finished == PumpResult::Failed)
+    {
+        return errorResult("failed waiting for login");
+    }
+    counters.timeouts++;
+    return errorResult("timed out waiting for login");
+}
+
+// authenticate implements the synchronous Authenticate exports after they've checked the token cache. It
+// records the durations of the request's phases in timings.
+TokenResult authenticate(const std::string &authority, const std::string &scope, const std::string &accountID, bool allowPrompt, const WaitOptions &options, Timings &timings)
+{
+    auto waiter = std::make_shared<Waiter>();
+    if (options.cancellationID)
+    {
+        cancellations.Register(options.cancellationID, waiter);
+    }
+    auto result = authenticateWith(waiter, authority, scope, accountID, allowPrompt, options, timings);
+    if (options.cancellationID)
+    {
+        cancellations.Unregister(options.cancellationID);
+    }
+    return result;
+}
+
+WrappedAuthResult *Authenticate(const char *authority, const char *scope, const char *accountID, bool allowPrompt)
+{
+    TraceSpan span("Authenticate");
+    if (auto cached = getCachedToken(str(authority), str(scope), str(accountID)))
+    {
+        return wrapAuthResult(fromCachedToken(*cached));
+    }
+    Timings timings;
+    return wrapAuthResult(authenticate(str(authority), str(scope), str(accountID), allowPrompt, WaitOptions(), timings));
+}
+
+// authenticatePacked implements AuthenticatePacked and AuthenticateEx
+PackedAuthResult *authenticatePacked(const std::string &authority, const std::string &scope, const std::string &accountID, bool allowPrompt, const WaitOptions &options)
+{
+    if (auto cached = getCachedToken(authority, scope, accountID))
+    {
+        // pack the cached token directly, so a cache hit costs only the packed result's allocation
+        return packAuthResult(cached->accountID, cached->token, cached->expiresOn, "");
+    }
+    Timings timings;
+    auto result = authenticate(authority, scope, accountID, allowPrompt, options, timings);
+    return packAuthResult(result, timings);
+}
+
+PackedAuthResult *AuthenticatePacked(const char *authority, const char *scope, const char *accountID, bool allowPrompt)
+{
+    TraceSpan span("AuthenticatePacked");
+    return authenticatePacked(str(authority), str(scope), str(accountID), allowPrompt, WaitOptions());
+}
+
+// validRequest returns true when request is large enough to contain the fields every version of
+// AuthenticateRequest has
+bool validRequest(const AuthenticateRequest *request)
+{
+    return request && request->size >= offsetof(AuthenticateRequest, allowPrompt) + sizeof(request->allowPrompt);
+}
+
+// waitOptions returns the WaitOptions of a request, which callers built against an older version of
+// AuthenticateRequest don't specify
+WaitOptions waitOptions(const AuthenticateRequest *request)
+{
+    WaitOptions options;
+    if (request->size >= offsetof(AuthenticateRequest, cancellationID) + sizeof(request->cancellationID))
+    {
+        if (request->deadline > 0)
         {
-            auto ar = new WrappedAuthResult();
-            ar->errorDescription = strdup("timed out waiting for login");
-            return ar;
+            auto deadline = std::chrono::system_clock::time_point(std::chrono::milliseconds(request->deadline));
+            auto &clock = GetClock();
+            options.deadline = clock.Now() + (deadline - clock.SystemNow());
         }
+        options.cancellationID = request->cancellationID;
     }
+    return options;
+}
 
-    auto res = future.get();
-    return wrapAuthResult(&res);
+// field returns a length-delimited string from an AuthenticateRequest
+std::string field(const char *s, uint32_t length)
+{
+    return s ? std::string(s, length) : std::string();
+}
+
+// cacheOnly returns true when request asks only for a cached token, which callers built against an older version of
+// AuthenticateRequest can't
+bool cacheOnly(const AuthenticateRequest *request)
+{
+    return request->size >= offsetof(AuthenticateRequest, cacheOnly) + sizeof(request->cacheOnly) && request->cacheOnly;
+}
+
+// authenticateCached implements cache-only AuthenticateEx requests. It doesn't schedule refreshes because the
+// bridge may not be started.
+PackedAuthResult *authenticateCached(const std::string &authority, const std::string &scope, const std::string &accountID)
+{
+    auto cached = tokenCache.Get(authority, scope, accountID);
+    if (!cached)
+    {
+        cached = getPersistedToken(authority, scope, accountID);
+    }
+    if (!cached)
+    {
+        return packAuthResult(errorResult(notCached));
+    }
+    return packAuthResult(cached->accountID, cached->token, cached->expiresOn, "");
+}
+
+PackedAuthResult *AuthenticateEx(const AuthenticateRequest *request)
+{
+    TraceSpan span("AuthenticateEx");
+    if (!validRequest(request))
+    {
+        return packAuthResult(errorResult("invalid authentication request"));
+    }
+    if (cacheOnly(request))
+    {
+        return authenticateCached(
+            field(request->authority, request->authorityLength),
+            field(request->scope, request->scopeLength),
+            field(request->accountID, request->accountIDLength));
+    }
+    return authenticatePacked(
+        field(request->authority, request->authorityLength),
+        field(request->scope, request->scopeLength),
+        field(request->accountID, request->accountIDLength),
+        request->allowPrompt,
+        waitOptions(request));
+}
+
+void CancelAuthenticate(uint64_t cancellationID)
+{
+    if (cancellationID)
+    {
+        cancellations.Cancel(cancellationID);
+    }
 }
 
 WrappedAuthResult *SignInSilently()
 {
-    std::promise<AuthResult> promise;
-    auto callback = [&promise](const AuthResult &result)
+    TraceSpan span("SignInSilently");
+    auto startupError = awaitStartup();
+    if (!startupError.empty())
     {
-        promise.set_value(result);
-    };
-    OneAuth::GetAuthenticator()->SignInSilently(std::nullopt, TelemetryParameters(UUID::Generate()), callback);
-    auto future = promise.get_future();
-    if (future.wait_for(std::chrono::seconds(timeoutSeconds)) != std::future_status::ready)
+        return wrapAuthResult(errorResult(startupError.c_str()));
+    }
+    auto pending = std::make_shared<PendingAuth>();
+    auto correlationID = backend().NewCorrelationID();
+    backend().SignInSilently(correlationID, completer(pending, correlationID, "SignInSilently"));
+    if (auto result = pending->Wait(std::chrono::seconds(timeoutSeconds)))
+    {
+        return wrapAuthResult(*result);
+    }
+    counters.timeouts++;
+    return wrapAuthResult(errorResult("timed out signing in with system account"));
+}
+
+WrappedAuthResult *AuthenticateMany(const TokenRequest *requests, int count, const char *accountID)
+{
+    TraceSpan span("AuthenticateMany");
+    if (!requests || count <= 0)
+    {
+        return nullptr;
+    }
+    auto results = new WrappedAuthResult[count]();
+    auto id = str(accountID);
+    std::vector<std::shared_ptr<PendingAuth>> pending(count);
+    std::shared_ptr<BackendAccount> account;
+    std::string startupError;
+    auto accountRead = false;
+    for (int i = 0; i < count; i++)
+    {
+        auto authority = str(requests[i].authority);
+        auto scope = str(requests[i].scope);
+        if (id.empty())
+        {
+            pending[i] = completed(errorResult(interactionRequired));
+        }
+        else if (auto cached = getCachedToken(authority, scope, id))
+        {
+            pending[i] = completed(fromCachedToken(*cached));
+        }
+        else if (auto p = inflight.Find(tokenKey(authority, scope, id)))
+        {
+            pending[i] = p;
+        }
+        else
+        {
+            // read the account only when some request needs it, and only once
+            if (!accountRead)
+            {
+                startupError = awaitStartup();
+                account = startupError.empty() ? readAccount(id) : nullptr;
+                accountRead = true;
+            }
+            if (account)
+            {
+                pending[i] = acquireSilently(*account, authority, scope);
+            }
+            else
+            {
+                pending[i] = completed(errorResult(startupError.empty() ? interactionRequired : startupError.c_str()));
+            }
+        }
+    }
+
+    // the acquisitions proceed concurrently, so they share one deadline
+    auto &clock = GetClock();
+    auto deadline = clock.Now() + std::chrono::seconds(timeoutSeconds);
+    for (int i = 0; i < count; i++)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock.Now());
+        auto result = pending[i]->Wait(std::max(remaining, std::chrono::milliseconds(0)));
+        if (!result)
+        {
+            counters.timeouts++;
+        }
+        fillWrappedAuthResult(&results[i], result ? *result : errorResult("timed out waiting for silent authentication"));
+    }
+    return results;
+}
+
+// newAuthRequest returns a handle for an asynchronous request
+AuthRequest *newAuthRequest(std::shared_ptr<PendingAuth> pending, AuthCompletion completion, uintptr_t context)
+{
+    auto request = new AuthRequest{pending, 0};
+    if (completion)
+    {
+        request->subscription = pending->Subscribe([completion, context]
+                                                   { completion(context); });
+    }
+    return request;
+}
+
+// authenticateAsync implements AuthenticateAsync and AuthenticateAsyncEx
+AuthRequest *authenticateAsync(const std::string &authority, const std::string &scope, const std::string &accountID, AuthCompletion completion, uintptr_t context)
+{
+    TraceSpan span("AuthenticateAsync");
+    std::shared_ptr<PendingAuth> pending;
+    if (!accountID.empty())
+    {
+        if (auto cached = getCachedToken(authority, scope, accountID))
+        {
+            pending = completed(fromCachedToken(*cached));
+        }
+        else
+        {
+            auto startupError = awaitStartup();
+            pending = startupError.empty() ? acquireSilently(authority, scope, accountID) : completed(errorResult(startupError.c_str()));
+        }
+    }
+    if (!pending)
+    {
+        pending = completed(errorResult(interactionRequired));
+    }
+    return newAuthRequest(pending, completion, context);
+}
+
+AuthRequest *AuthenticateAsync(const char *authority, const char *scope, const char *accountID, AuthCompletion completion, uintptr_t context)
+{
+    return authenticateAsync(str(authority), str(scope), str(accountID), completion, context);
+}
+
+AuthRequest *AuthenticateAsyncEx(const AuthenticateRequest *request, AuthCompletion completion, uintptr_t context)
+{
+    if (!validRequest(request))
+    {
+        return newAuthRequest(completed(errorResult("invalid authentication request")), completion, context);
+    }
+    return authenticateAsync(
+        field(request->authority, request->authorityLength),
+        field(request->scope, request->scopeLength),
+        field(request->accountID, request->accountIDLength),
+        completion,
+        context);
+}
+
+AuthRequest *StartupAsync(const char *clientId, const char *applicationId, const char *version, Logger logger, AuthCompletion completion, uintptr_t context)
+{
+    tracer.Enable();
+    resetStartup();
+    auto pending = std::make_shared<PendingAuth>();
+    {
+        std::lock_guard<std::mutex> lock(startupMu);
+        startupRequest = pending;
+        starting.store(true);
+    }
+    // the worker's thread lasts until Shutdown, so state the backend keeps for the thread that started it, such as
+    // OLE's, lasts as long as the backend
+    worker.Start();
+    worker.Post(
+        [pending, clientId = str(clientId), applicationId = str(applicationId), version = str(version), logger]()
+        {
+            TokenResult result;
+            result.error = startup(clientId, applicationId, version, logger);
+            if (result.error.empty())
+            {
+                std::lock_guard<std::mutex> lock(startupMu);
+                if (startupRequest == pending)
+                {
+                    starting.store(false);
+                }
+            }
+            pending->Complete(std::move(result));
+        });
+    return newAuthRequest(pending, completion, context);
+}
+
+void Warmup(const char *authority, const char *scope, const char *accountId)
+{
+    auto s = str(scope);
+    worker.Post(
+        [authority = str(authority), scope = s.empty() ? defaultScope : s, accountID = str(accountId)]()
+        {
+            if (accountID.empty() || !awaitStartup().empty())
+            {
+                return;
+            }
+            TraceSpan span("Warmup");
+            // an earlier request, or an earlier process, may have cached the token already
+            if (tokenCache.Get(authority, scope, accountID) || getPersistedToken(authority, scope, accountID))
+            {
+                return;
+            }
+            // reading the account caches it, and nothing waits for the acquisition; its callback caches the token
+            acquireSilently(authority, scope, accountID);
+        });
+}
+
+AuthRequest *SignInSilentlyAsync(AuthCompletion completion, uintptr_t context)
+{
+    auto startupError = awaitStartup();
+    if (!startupError.empty())
     {
-        auto ar = new WrappedAuthResult();
-        ar->errorDescription = strdup("timed out signing in with system account");
-        return ar;
+        return newAuthRequest(completed(errorResult(startupError.c_str())), completion, context);
+    }
+    auto pending = std::make_shared<PendingAuth>();
+    auto correlationID = backend().NewCorrelationID();
+    backend().SignInSilently(correlationID, completer(pending, correlationID, "SignInSilently"));
+    return newAuthRequest(pending, completion, context);
+}
+
+bool PollAuthRequest(AuthRequest *request)
+{
+    return request && request->pending->Done();
+}
+
+WrappedAuthResult *WaitAuthRequest(AuthRequest *request, int timeoutMilliseconds)
+{
+    if (request)
+    {
+        if (auto result = request->pending->Wait(std::chrono::milliseconds(timeoutMilliseconds)))
+        {
+            return wrapAuthResult(*result);
+        }
     }
-    auto res = future.get();
-    return wrapAuthResult(&res);
+    return nullptr;
+}
+
+PackedAuthResult *WaitAuthRequestPacked(AuthRequest *request, int timeoutMilliseconds)
+{
+    if (request)
+    {
+        if (auto result = request->pending->Wait(std::chrono::milliseconds(timeoutMilliseconds)))
+        {
+            return packAuthResult(*result);
+        }
+    }
+    return nullptr;
+}
+
+void FreeAuthRequest(AuthRequest *request)
+{
+    if (request)
+    {
+        // the backend may still call back for this request, and other callers may be waiting for it; that's
+        // safe because they share ownership of the pending state, however this caller doesn't want its
+        // completion callback any more
+        request->pending->Unsubscribe(request->subscription);
+        delete request;
+    }
+}
+
+WrappedError *OpenTokenCacheFile(const char *path, const char *clientId)
+{
+    if (str(path).empty())
+    {
+        persistentTokens.Close();
+        return nullptr;
+    }
+    auto error = persistentTokens.Open(str(path), str(clientId));
+    if (error.empty())
+    {
+        return nullptr;
+    }
+    auto wrapped = new WrappedError();
+    wrapped->message = strdup(error.c_str());
+    return wrapped;
+}
+
+void ConfigureTokenCache(int expirySkewSeconds)
+{
+    tokenCache.SetExpirySkew(std::chrono::seconds(expirySkewSeconds));
+    persistentTokens.SetExpirySkew(std::chrono::seconds(expirySkewSeconds));
+}
+
+void ConfigureTokenRefresh(int refreshWindowSeconds)
+{
+    tokenCache.SetRefreshWindow(std::chrono::seconds(refreshWindowSeconds));
+}
+
+void SetLogOptions(int level, int maxPerSecond)
+{
+    auto l = std::clamp(level, 0, 4);
+    logLevel.store(l);
+    logLimiter.SetLimit(static_cast<uint32_t>(std::max(maxPerSecond, 0)));
+    backend().SetLogging(l, logCallback);
+}
+
+void GetAccountCacheStats(AccountCacheStats *stats)
+{
+    if (stats)
+    {
+        stats->hits = accounts.Hits();
+        stats->misses = accounts.Misses();
+    }
+}
+
+void GetBridgeStats(BridgeStats *stats)
+{
+    if (stats && stats->size >= sizeof(BridgeStats))
+    {
+        counters.Read(stats);
+    }
+}
+
+const char *GetBridgeBuildId()
+{
+    return BRIDGE_BUILD_ID;
 }
 
 void Logout()
 {
-    auto telemetryParams = TelemetryParameters(UUID::Generate());
-    for (auto a : OneAuth::GetAuthenticator()->ReadAssociatedAccounts(telemetryParams))
+    TraceSpan span("Logout");
+    Stopwatch stopwatch(counters.logout);
+    accounts.Clear();
+    tokenCache.Clear();
+    persistentTokens.Clear();
+    if (awaitStartup().empty())
     {
-        // SignOut* delete data based on client ID i.e. they would sign the account
-        // out from az as well so long as azd and az share a client ID. Dis/associate
-        // use application ID e.g. "com.microsoft.azd" instead.
-        OneAuth::GetAuthenticator()->DisassociateAccount(a, telemetryParams, "");
+        backend().SignOut();
     }
 }
 
@@ -202,6 +1016,26 @@ void FreeWrappedAuthResult(WrappedAuthResult *WrappedAuthResult)
     }
 }
 
+void FreeWrappedAuthResults(WrappedAuthResult *results, int count)
+{
+    if (results)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            free(results[i].accountID);
+            free(results[i].errorDescription);
+            free(results[i].token);
+        }
+        delete[] results;
+    }
+}
+
+void FreePackedAuthResult(PackedAuthResult *result)
+{
+    // the result and its strings are one allocation
+    free(result);
+}
+
 void FreeWrappedError(WrappedError *error)
 {
     if (error)
@@ -210,3 +1044,55 @@ void FreeWrappedError(WrappedError *error)
         delete error;
     }
 }
+
+int DrainLogs(LogRecord *records, int capacity, uint64_t *dropped)
+{
+    int n = 0;
+    while (records && n < capacity && logs.Pop(&records[n]))
+    {
+        n++;
+    }
+    if (dropped)
+    {
+        *dropped = logs.Dropped();
+    }
+    return n;
+}
+
+void GetBridgeFunctions(BridgeFunctions *functions)
+{
+    if (!functions || functions->size < sizeof(BridgeFunctions))
+    {
+        return;
+    }
+    functions->freeWrappedAuthResult = FreeWrappedAuthResult;
+    functions->freeWrappedAuthResults = FreeWrappedAuthResults;
+    functions->freePackedAuthResult = FreePackedAuthResult;
+    functions->freeWrappedError = FreeWrappedError;
+    functions->drainLogs = DrainLogs;
+    functions->startup = Startup;
+    functions->startupAsync = StartupAsync;
+    functions->warmup = Warmup;
+    functions->authenticate = Authenticate;
+    functions->authenticatePacked = AuthenticatePacked;
+    functions->authenticateEx = AuthenticateEx;
+    functions->cancelAuthenticate = CancelAuthenticate;
+    functions->authenticateMany = AuthenticateMany;
+    functions->openTokenCacheFile = OpenTokenCacheFile;
+    functions->configureTokenCache = ConfigureTokenCache;
+    functions->configureTokenRefresh = ConfigureTokenRefresh;
+    functions->setLogOptions = SetLogOptions;
+    functions->signInSilently = SignInSilently;
+    functions->authenticateAsync = AuthenticateAsync;
+    functions->authenticateAsyncEx = AuthenticateAsyncEx;
+    functions->signInSilentlyAsync = SignInSilentlyAsync;
+    functions->pollAuthRequest = PollAuthRequest;
+    functions->waitAuthRequest = WaitAuthRequest;
+    functions->waitAuthRequestPacked = WaitAuthRequestPacked;
+    functions->freeAuthRequest = FreeAuthRequest;
+    functions->getAccountCacheStats = GetAccountCacheStats;
+    functions->getBridgeStats = GetBridgeStats;
+    functions->getBridgeBuildId = GetBridgeBuildId;
+    functions->logout = Logout;
+    functions->shutdown = Shutdown;
+}
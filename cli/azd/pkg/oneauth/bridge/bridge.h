@@ -1,7 +1,22 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License.
 
+#pragma once
+
 #include <stdbool.h>
+#include <stdint.h>
+
+// BRIDGE_API marks the bridge's exports. The bridge builds as a DLL on Windows and, with the fake backend, as a
+// shared library elsewhere.
+#if defined(_WIN32)
+#if defined(BRIDGE_EXPORTS)
+#define BRIDGE_API __declspec(dllexport)
+#else
+#define BRIDGE_API __declspec(dllimport)
+#endif
+#else
+#define BRIDGE_API __attribute__((visibility("default")))
+#endif
 
 #ifdef __cplusplus
 extern "C"
@@ -10,6 +25,13 @@ extern "C"
 
     typedef void (*Logger)(const char *);
 
+    // LogRecord is a log message buffered by the bridge. Messages longer than the buffer are truncated.
+    typedef struct
+    {
+        uint32_t length;
+        char message[1024];
+    } LogRecord;
+
     typedef struct
     {
         char *accountID;
@@ -18,21 +40,188 @@ extern "C"
         char *token;
     } WrappedAuthResult;
 
+    // PackedAuthResult is an alternative to WrappedAuthResult that occupies a single allocation. Its strings are stored after the
+    // struct in the order accountID, token, errorDescription, correlationID, each NUL-terminated. Absent strings have length 0 and
+    // a NULL pointer.
+    typedef struct
+    {
+        int64_t expiresOn;
+        uint32_t accountIDLength;
+        uint32_t tokenLength;
+        uint32_t errorLength;
+        const char *accountID;
+        const char *token;
+        const char *error;
+        // correlationID identifies the OneAuth request that produced the result in OneAuth's telemetry and logs. It's absent
+        // when the bridge didn't call OneAuth, for example because it had the requested token cached.
+        const char *correlationID;
+        uint32_t correlationIDLength;
+        // The time the call spent in each phase, in microseconds. Phases the call didn't go through, or didn't measure, are 0.
+        // accountLookup includes finding the account and starting a silent request; silentWait is waiting for that request;
+        // pump is pumping messages for a login window; marshal is building this result.
+        uint32_t accountLookupMicroseconds;
+        uint32_t silentWaitMicroseconds;
+        uint32_t pumpMicroseconds;
+        uint32_t marshalMicroseconds;
+    } PackedAuthResult;
+
     typedef struct
     {
         char *message;
     } WrappedError;
 
-    __declspec(dllexport) void FreeWrappedAuthResult(WrappedAuthResult *);
-    __declspec(dllexport) void FreeWrappedError(WrappedError *);
+    typedef struct
+    {
+        const char *authority;
+        const char *scope;
+    } TokenRequest;
 
-    // Startup OneAuth. Returns an error message if this fails, NULL if it succeeds.
+    // AuthenticateRequest describes a token request by length-delimited strings, so callers can build requests in a reusable
+    // buffer and the bridge needn't scan for terminators. Strings needn't be NUL-terminated; a NULL string is empty.
+    typedef struct
+    {
+        // size must be sizeof(AuthenticateRequest). It allows adding fields without breaking callers built against an older
+        // version of this header.
+        uint32_t size;
+        uint32_t authorityLength;
+        uint32_t scopeLength;
+        uint32_t accountIDLength;
+        const char *authority;
+        const char *scope;
+        const char *accountID;
+        bool allowPrompt;
+        // deadline is when the bridge stops waiting for authentication, in milliseconds since the Unix epoch. When 0, the bridge
+        // waits up to 60 seconds for each phase of authentication.
+        int64_t deadline;
+        // cancellationID is a caller-chosen, nonzero ID for cancelling the request with CancelAuthenticate. When 0, the request
+        // can't be cancelled.
+        uint64_t cancellationID;
+        // cacheOnly requests a cached token only. AuthenticateEx answers such a request without starting OneAuth, so the
+        // bridge needn't be started, and returns an error result when neither token cache has the token.
+        bool cacheOnly;
+    } AuthenticateRequest;
+
+    typedef struct
+    {
+        uint64_t hits;
+        uint64_t misses;
+    } AccountCacheStats;
+
+    // LatencyHistogram summarizes the durations of an operation. buckets[0] counts operations taking less than 1 millisecond,
+    // buckets[i] those taking at least 2^(i-1) and less than 2^i milliseconds, and the last bucket all longer operations.
+    typedef struct
+    {
+        uint64_t count;
+        uint64_t totalMicroseconds;
+        uint64_t buckets[20];
+    } LatencyHistogram;
+
+    // BridgeStats are the bridge's performance counters since it loaded
+    typedef struct
+    {
+        // size must be sizeof(BridgeStats). It allows adding counters without breaking callers built against an older version
+        // of this header.
+        uint32_t size;
+        // startup, readAccount and logout time the Startup export, OneAuth's ReadAccountById and the Logout export
+        LatencyHistogram startup;
+        LatencyHistogram readAccount;
+        // silentAcquisition and interactiveSignIn time OneAuth token requests from request to callback
+        LatencyHistogram silentAcquisition;
+        LatencyHistogram interactiveSignIn;
+        // pumpIterations times the message dispatching of each iteration of the login window's message pump
+        LatencyHistogram pumpIterations;
+        LatencyHistogram logout;
+        // timeouts counts requests the bridge stopped waiting for
+        uint64_t timeouts;
+        // errors counts OneAuth results having an error
+        uint64_t errors;
+    } BridgeStats;
+
+    // AuthRequest is an opaque handle to an asynchronous authentication request
+    typedef struct AuthRequest AuthRequest;
+
+    // AuthCompletion is called with the context given to an asynchronous export when the request completes. It may be called on
+    // any thread, including the one that started the request, before the export returns.
+    typedef void (*AuthCompletion)(uintptr_t context);
+
+    // BridgeFunctions holds the addresses of the bridge's exports, so a program loading the bridge at run time can find all of
+    // them with one call to GetBridgeFunctions. Each member is the export having the same name in PascalCase.
+    typedef struct
+    {
+        // size must be sizeof(BridgeFunctions). It allows adding functions, after the existing ones, without breaking callers
+        // built against an older version of this header.
+        uint32_t size;
+        void (*freeWrappedAuthResult)(WrappedAuthResult *);
+        void (*freeWrappedAuthResults)(WrappedAuthResult *, int);
+        void (*freePackedAuthResult)(PackedAuthResult *);
+        void (*freeWrappedError)(WrappedError *);
+        int (*drainLogs)(LogRecord *, int, uint64_t *);
+        WrappedError *(*startup)(const char *, const char *, const char *, Logger);
+        AuthRequest *(*startupAsync)(const char *, const char *, const char *, Logger, AuthCompletion, uintptr_t);
+        void (*warmup)(const char *, const char *, const char *);
+        WrappedAuthResult *(*authenticate)(const char *, const char *, const char *, bool);
+        PackedAuthResult *(*authenticatePacked)(const char *, const char *, const char *, bool);
+        PackedAuthResult *(*authenticateEx)(const AuthenticateRequest *);
+        void (*cancelAuthenticate)(uint64_t);
+        WrappedAuthResult *(*authenticateMany)(const TokenRequest *, int, const char *);
+        WrappedError *(*openTokenCacheFile)(const char *, const char *);
+        void (*configureTokenCache)(int);
+        void (*configureTokenRefresh)(int);
+        void (*setLogOptions)(int, int);
+        WrappedAuthResult *(*signInSilently)(void);
+        AuthRequest *(*authenticateAsync)(const char *, const char *, const char *, AuthCompletion, uintptr_t);
+        AuthRequest *(*authenticateAsyncEx)(const AuthenticateRequest *, AuthCompletion, uintptr_t);
+        AuthRequest *(*signInSilentlyAsync)(AuthCompletion, uintptr_t);
+        bool (*pollAuthRequest)(AuthRequest *);
+        WrappedAuthResult *(*waitAuthRequest)(AuthRequest *, int);
+        PackedAuthResult *(*waitAuthRequestPacked)(AuthRequest *, int);
+        void (*freeAuthRequest)(AuthRequest *);
+        void (*getAccountCacheStats)(AccountCacheStats *);
+        void (*getBridgeStats)(BridgeStats *);
+        const char *(*getBridgeBuildId)(void);
+        void (*logout)(void);
+        void (*shutdown)(void);
+    } BridgeFunctions;
+
+    BRIDGE_API void FreeWrappedAuthResult(WrappedAuthResult *);
+    BRIDGE_API void FreeWrappedAuthResults(WrappedAuthResult *, int count);
+    BRIDGE_API void FreePackedAuthResult(PackedAuthResult *);
+    BRIDGE_API void FreeWrappedError(WrappedError *);
+
+    // DrainLogs moves up to capacity buffered log messages, oldest first, into records and returns the number it moved. The
+    // bridge buffers a bounded number of messages and drops new messages while the buffer is full or the rate limit set by
+    // SetLogOptions is exceeded. When dropped isn't NULL, DrainLogs sets it to the number of messages dropped since the bridge
+    // loaded.
+    BRIDGE_API int DrainLogs(LogRecord *records, int capacity, uint64_t *dropped);
+
+    // Startup OneAuth, or the fake backend when the bridge is built with BRIDGE_FAKE_BACKEND. Returns an error message if this fails, NULL if it succeeds. When the environment variable
+    // AZD_ONEAUTH_TRACE_FILE names a file, the bridge records its operations as Chrome trace events and writes them to that file
+    // on Shutdown.
+    // When AZD_ONEAUTH_RECORD_FILE names a file, the bridge records its calls to the backend in that file on Shutdown, and a
+    // bridge built with BRIDGE_FAKE_BACKEND replays the calls recorded in the file AZD_ONEAUTH_REPLAY_FILE names instead of
+    // faking them.
     // The parameters are:
     // - clientId: the client ID of the application
     // - applicationId: an identifier for the application e.g. "com.microsoft.azd"
     // - version: the application version
-    // - logCallback: a function to call with log messages
-    __declspec(dllexport) WrappedError *Startup(const char *clientId, const char *applicationId, const char *version, Logger logCallback);
+    // - logCallback: a function to call with log messages, or NULL to have the bridge buffer them for DrainLogs. The bridge
+    //   calls logCallback on OneAuth's threads.
+    BRIDGE_API WrappedError *Startup(const char *clientId, const char *applicationId, const char *version, Logger logCallback);
+
+    // StartupAsync is Startup on a bridge thread. It returns a handle to the startup without waiting for OneAuth, so the caller can
+    // continue initializing while OneAuth starts. The handle and completion behave as for AuthenticateAsync, and the handle's result
+    // has an error when startup fails. Exports that need OneAuth wait for the startup to finish and fail when it fails, but return
+    // cached tokens without waiting. Shutdown waits for a startup in progress.
+    BRIDGE_API AuthRequest *StartupAsync(const char *clientId, const char *applicationId, const char *version, Logger logCallback, AuthCompletion completion, uintptr_t context);
+
+    // Warmup prepares the bridge for azd's first token request. After Startup or StartupAsync, it reads the given account and
+    // silently acquires a token for it on a bridge thread, without waiting for either, so that a later Authenticate for the
+    // same authority, scope and account returns a cached token. Warmup does nothing when the token is already cached, and a
+    // failure leaves nothing cached. The parameters are:
+    // - authority: authority for the token request, as for Authenticate
+    // - scope: scope of the token, without "/.default", or NULL for the ARM scope "https://management.azure.com/"
+    // - accountId: ID of the account, as returned by Authenticate. Warmup does nothing when it's NULL or empty.
+    BRIDGE_API void Warmup(const char *authority, const char *scope, const char *accountId);
 
     // Authenticate acquires an access token. It will display an interactive login window if necessary, unless allowPrompt is false.
     // The parameters are:
@@ -42,16 +231,108 @@ extern "C"
     //              authentication. If empty or no account associated with azd matches the given value, this function will fall back to
     //              interactive authentication, provided allowPrompt is true.
     // - allowPrompt: whether to display an interactive login window when necessary
-    __declspec(dllexport) WrappedAuthResult *Authenticate(const char *authority, const char *scope, const char *accountID, bool allowPrompt);
+    // When accountID is given and the token cache has an unexpired token for the same authority, scope and account, Authenticate
+    // returns that token without calling OneAuth.
+    BRIDGE_API WrappedAuthResult *Authenticate(const char *authority, const char *scope, const char *accountID, bool allowPrompt);
+
+    // AuthenticatePacked is Authenticate returning a PackedAuthResult, which the caller must free with FreePackedAuthResult.
+    BRIDGE_API PackedAuthResult *AuthenticatePacked(const char *authority, const char *scope, const char *accountID, bool allowPrompt);
+
+    // AuthenticateEx is AuthenticatePacked taking its parameters in an AuthenticateRequest. OneAuth appends "/.default" to scopes,
+    // so callers should remove that suffix. The bridge doesn't retain the request or its strings after returning. Unlike
+    // Authenticate, AuthenticateEx honors a deadline, cancellation and cacheOnly, in which cases it may return an error result.
+    BRIDGE_API PackedAuthResult *AuthenticateEx(const AuthenticateRequest *request);
+
+    // CancelAuthenticate cancels the AuthenticateEx call whose request has the given cancellationID, if one is waiting. That call
+    // returns promptly, and a OneAuth callback arriving afterward is ignored. It doesn't close a login window OneAuth displayed;
+    // the window stops responding until the thread pumps messages again. Cancelling an ID whose call hasn't started yet cancels
+    // that call when it starts.
+    BRIDGE_API void CancelAuthenticate(uint64_t cancellationID);
+
+    // AuthenticateMany silently acquires access tokens for several authority and scope pairs on behalf of one account. It starts
+    // all acquisitions before waiting for any of them, so it takes about as long as the slowest. It returns an array of count
+    // results, in the order of requests, which the caller must free with FreeWrappedAuthResults. A request that would require
+    // interactive authentication has an error result. Returns NULL when count isn't positive.
+    BRIDGE_API WrappedAuthResult *AuthenticateMany(const TokenRequest *requests, int count, const char *accountID);
+
+    // OpenTokenCacheFile opens a token cache file shared by every process of the user, so a process can return tokens an earlier
+    // process acquired without starting OneAuth. The bridge adds the tokens it acquires to the file and, when its in-memory cache
+    // doesn't have a token, looks for the token in the file. The file stays open until the bridge unloads or OpenTokenCacheFile
+    // opens another, and Logout clears it. OpenTokenCacheFile may be called before Startup. Returns an error message if this
+    // fails, NULL if it succeeds. The parameters are:
+    // - path: the file's path, which should be in a directory only the user can access. The bridge creates the file if necessary.
+    //         NULL or an empty path closes the open file.
+    // - clientId: the client ID of the application, as for Startup. The file keeps each client's tokens separately.
+    BRIDGE_API WrappedError *OpenTokenCacheFile(const char *path, const char *clientId);
+
+    // ConfigureTokenCache configures the in-memory cache Authenticate uses to return tokens without a round trip through OneAuth.
+    // The parameters are:
+    // - expirySkewSeconds: Authenticate won't return a cached token that expires within this many seconds (default 300). A negative
+    //                      value disables the cache.
+    // The skew applies to the token cache file as well.
+    BRIDGE_API void ConfigureTokenCache(int expirySkewSeconds);
+
+    // ConfigureTokenRefresh enables refreshing cached tokens ahead of their expiration. When Authenticate, AuthenticateAsync or
+    // AuthenticateMany finds a cached token that expires within refreshWindowSeconds, it returns that token immediately and the
+    // bridge silently acquires a new one in the background, for later calls. A window no longer than the cache's expiry skew
+    // disables refresh-ahead, which is the default.
+    BRIDGE_API void ConfigureTokenRefresh(int refreshWindowSeconds);
+
+    // SetLogOptions configures logging and may be called at any time, including before Startup. The parameters are:
+    // - level: the most verbose messages to log. 0 disables logging, 1 logs errors, 2 warnings, 3 information (the default) and
+    //          4 everything. OneAuth doesn't format messages more verbose than this.
+    // - maxPerSecond: the bridge drops messages beyond this many per second. 0 means no limit, which is the default.
+    BRIDGE_API void SetLogOptions(int level, int maxPerSecond);
 
     // SignInSilently authenticates an account inferred from the OS e.g. the active Windows user, without displaying UI.
     // It returns an error when that's impossible.
-    __declspec(dllexport) WrappedAuthResult *SignInSilently();
+    BRIDGE_API WrappedAuthResult *SignInSilently();
+
+    // AuthenticateAsync starts silent authentication and returns a handle to the request without waiting for OneAuth. Its parameters
+    // are as for Authenticate, except it never displays a login window; when silent authentication isn't possible, the request
+    // completes with an error. completion may be NULL. Callers must free the handle with FreeAuthRequest. OneAuth may never complete
+    // a request, so callers should bound their wait.
+    BRIDGE_API AuthRequest *AuthenticateAsync(const char *authority, const char *scope, const char *accountID, AuthCompletion completion, uintptr_t context);
+
+    // AuthenticateAsyncEx is AuthenticateAsync taking its parameters in an AuthenticateRequest. It ignores allowPrompt, deadline
+    // and cancellationID; callers of the asynchronous exports choose how long to wait and can free a request at any time.
+    BRIDGE_API AuthRequest *AuthenticateAsyncEx(const AuthenticateRequest *request, AuthCompletion completion, uintptr_t context);
+
+    // SignInSilentlyAsync is an asynchronous version of SignInSilently. Its handle and completion behave as for AuthenticateAsync.
+    BRIDGE_API AuthRequest *SignInSilentlyAsync(AuthCompletion completion, uintptr_t context);
+
+    // PollAuthRequest returns true when an asynchronous request has completed.
+    BRIDGE_API bool PollAuthRequest(AuthRequest *request);
+
+    // WaitAuthRequest waits up to timeoutMilliseconds for an asynchronous request to complete. It returns the request's result, which
+    // the caller must free with FreeWrappedAuthResult, or NULL when the request didn't complete in time. A timeout of 0 doesn't wait.
+    BRIDGE_API WrappedAuthResult *WaitAuthRequest(AuthRequest *request, int timeoutMilliseconds);
+
+    // WaitAuthRequestPacked is WaitAuthRequest returning a PackedAuthResult, which the caller must free with FreePackedAuthResult.
+    BRIDGE_API PackedAuthResult *WaitAuthRequestPacked(AuthRequest *request, int timeoutMilliseconds);
+
+    // FreeAuthRequest frees a handle returned by an asynchronous export. It's safe to call before the request completes, in which
+    // case the bridge discards the request's result and doesn't call its completion callback, unless that call is already underway.
+    BRIDGE_API void FreeAuthRequest(AuthRequest *request);
+
+    // GetAccountCacheStats reports how often the bridge found an account in its cache rather than reading it from OneAuth.
+    BRIDGE_API void GetAccountCacheStats(AccountCacheStats *stats);
+
+    // GetBridgeStats writes the bridge's performance counters to stats. It does nothing when stats->size is too small.
+    BRIDGE_API void GetBridgeStats(BridgeStats *stats);
+
+    // GetBridgeBuildId returns an identifier of the bridge's build, which changes when the bridge's sources, dependencies or
+    // toolchain do. The string is static; callers mustn't free it. GetBridgeBuildId may be called before Startup.
+    BRIDGE_API const char *GetBridgeBuildId();
+
+    // Logout disassociates all accounts from the application and clears the token cache file.
+    BRIDGE_API void Logout();
 
-    // Logout disassociates all accounts from the application.
-    __declspec(dllexport) void Logout();
+    BRIDGE_API void Shutdown();
 
-    __declspec(dllexport) void Shutdown();
+    // GetBridgeFunctions writes the addresses of the bridge's exports to functions. It does nothing when functions->size is too
+    // small.
+    BRIDGE_API void GetBridgeFunctions(BridgeFunctions *functions);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,23 @@
+# Writes ${OUTPUT_DIR}/build_id.h, which defines BRIDGE_BUILD_ID, and ${OUTPUT_DIR}/build_id.txt, which contains the ID.
+# The ID is a hash of the bridge's sources, its vcpkg manifests and ${TOOLCHAIN}, so it changes whenever the bridge
+# could. The files change only when the ID does, so an unchanged bridge doesn't recompile.
+#
+# Usage: cmake -DSOURCE_DIR=<dir> -DOUTPUT_DIR=<dir> -DTOOLCHAIN=<description> -P build_id.cmake
+
+cmake_minimum_required(VERSION 3.25)
+
+file(GLOB sources RELATIVE ${SOURCE_DIR}
+     ${SOURCE_DIR}/*.cpp ${SOURCE_DIR}/*.h ${SOURCE_DIR}/backends/*/*.cpp ${SOURCE_DIR}/backends/*/*.h
+     ${SOURCE_DIR}/CMakeLists.txt ${SOURCE_DIR}/*.json)
+list(SORT sources)
+set(manifest "${TOOLCHAIN}\n")
+foreach(source IN LISTS sources)
+    file(SHA256 ${SOURCE_DIR}/${source} hash)
+    string(APPEND manifest "${source} ${hash}\n")
+endforeach()
+string(SHA256 BRIDGE_BUILD_ID "${manifest}")
+string(SUBSTRING ${BRIDGE_BUILD_ID} 0 32 BRIDGE_BUILD_ID)
+
+file(CONFIGURE OUTPUT ${OUTPUT_DIR}/build_id.h
+     CONTENT "// generated by build_id.cmake\n#pragma once\n\n#define BRIDGE_BUILD_ID \"@BRIDGE_BUILD_ID@\"\n" @ONLY)
+file(CONFIGURE OUTPUT ${OUTPUT_DIR}/build_id.txt CONTENT "@BRIDGE_BUILD_ID@" @ONLY)
@@ -0,0 +1,98 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "cancellation.h"
+#include "clock.h"
+
+namespace
+{
+    // maxEarly bounds the number of IDs Cancellations remembers for requests it hasn't seen. An ID
+    // cancelled before its request starts is usually registered immediately after.
+    const size_t maxEarly = 64;
+}
+
+void Waiter::Wake()
+{
+    std::function<void()> w;
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        w = waker;
+    }
+    cv.notify_all();
+    if (w)
+    {
+        w();
+    }
+}
+
+void Waiter::Cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        cancelled = true;
+    }
+    Wake();
+}
+
+bool Waiter::Cancelled()
+{
+    std::lock_guard<std::mutex> lock(mu);
+    return cancelled;
+}
+
+void Waiter::SetWaker(std::function<void()> w)
+{
+    std::lock_guard<std::mutex> lock(mu);
+    waker = std::move(w);
+}
+
+bool Waiter::WaitUntil(std::chrono::steady_clock::time_point deadline, const std::function<bool()> &ready)
+{
+    std::unique_lock<std::mutex> lock(mu);
+    auto done = false;
+    ::WaitUntil(GetClock(), cv, lock, deadline, [&]
+                { return (done = ready()) || cancelled; });
+    return done;
+}
+
+void Cancellations::Cancel(uint64_t id)
+{
+    std::shared_ptr<Waiter> waiter;
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = waiters.find(id);
+        if (it == waiters.end())
+        {
+            if (early.size() >= maxEarly)
+            {
+                early.clear();
+            }
+            early.insert(id);
+            return;
+        }
+        waiter = it->second.lock();
+    }
+    if (waiter)
+    {
+        waiter->Cancel();
+    }
+}
+
+void Cancellations::Register(uint64_t id, std::shared_ptr<Waiter> waiter)
+{
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        if (early.erase(id) == 0)
+        {
+            waiters[id] = waiter;
+            return;
+        }
+    }
+    waiter->Cancel();
+}
+
+void Cancellations::Unregister(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(mu);
+    waiters.erase(id);
+}
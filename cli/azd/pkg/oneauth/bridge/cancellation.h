@@ -0,0 +1,55 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+// Waiter blocks a caller until a request completes, a deadline passes or the caller cancels the request,
+// whichever happens first.
+class Waiter
+{
+public:
+    // Wake wakes the waiting caller so it can check whether its request has completed
+    void Wake();
+    // Cancel marks the request cancelled and wakes the waiting caller
+    void Cancel();
+    bool Cancelled();
+    // SetWaker sets a function Wake calls in addition to waking WaitUntil, for callers that wait in some other
+    // way, for example by pumping window messages
+    void SetWaker(std::function<void()> waker);
+    // WaitUntil waits until ready returns true, the request is cancelled or deadline passes. It returns ready's
+    // final value.
+    bool WaitUntil(std::chrono::steady_clock::time_point deadline, const std::function<bool()> &ready);
+
+private:
+    bool cancelled = false;
+    std::condition_variable cv;
+    std::mutex mu;
+    std::function<void()> waker;
+};
+
+// Cancellations maps caller-chosen IDs to the waiters of cancellable requests
+class Cancellations
+{
+public:
+    // Cancel cancels the request having the given ID. A request may be cancelled before it's registered
+    // because the caller may cancel it concurrently with starting it.
+    void Cancel(uint64_t id);
+    // Register makes waiter cancellable by id. If id was cancelled before this call, Register cancels waiter.
+    void Register(uint64_t id, std::shared_ptr<Waiter> waiter);
+    void Unregister(uint64_t id);
+
+private:
+    std::mutex mu;
+    // early holds IDs cancelled before registration
+    std::unordered_set<uint64_t> early;
+    std::unordered_map<uint64_t, std::weak_ptr<Waiter>> waiters;
+};
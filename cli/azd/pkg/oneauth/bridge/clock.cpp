@@ -0,0 +1,80 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "clock.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace
+{
+    // manualSlice is how often callers waiting on a ManualClock check whether it has passed their deadline
+    const auto manualSlice = std::chrono::milliseconds(1);
+
+    class SystemClock : public Clock
+    {
+    public:
+        std::chrono::steady_clock::time_point Now() override
+        {
+            return std::chrono::steady_clock::now();
+        }
+
+        std::chrono::system_clock::time_point SystemNow() override
+        {
+            return std::chrono::system_clock::now();
+        }
+
+        std::chrono::steady_clock::duration Slice(std::chrono::steady_clock::duration remaining) override
+        {
+            return remaining;
+        }
+    };
+
+    SystemClock systemClock;
+    std::atomic<Clock *> current{&systemClock};
+}
+
+ManualClock::ManualClock() : now(std::chrono::steady_clock::now()), systemNow(std::chrono::system_clock::now()) {}
+
+std::chrono::steady_clock::time_point ManualClock::Now()
+{
+    std::lock_guard<std::mutex> lock(mu);
+    return now;
+}
+
+std::chrono::system_clock::time_point ManualClock::SystemNow()
+{
+    std::lock_guard<std::mutex> lock(mu);
+    return systemNow;
+}
+
+std::chrono::steady_clock::duration ManualClock::Slice(std::chrono::steady_clock::duration remaining)
+{
+    return std::min<std::chrono::steady_clock::duration>(remaining, manualSlice);
+}
+
+void ManualClock::Advance(std::chrono::steady_clock::duration d)
+{
+    std::lock_guard<std::mutex> lock(mu);
+    now += d;
+    systemNow += std::chrono::duration_cast<std::chrono::system_clock::duration>(d);
+}
+
+Clock &GetClock()
+{
+    return *current.load();
+}
+
+void SetClock(Clock *clock)
+{
+    current.store(clock ? clock : &systemClock);
+}
+
+void SleepFor(Clock &clock, std::chrono::steady_clock::duration d)
+{
+    auto until = clock.Now() + d;
+    for (auto now = clock.Now(); now < until; now = clock.Now())
+    {
+        std::this_thread::sleep_for(clock.Slice(until - now));
+    }
+}
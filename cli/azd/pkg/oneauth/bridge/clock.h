@@ -0,0 +1,71 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+// Clock is the bridge's source of time for deadlines, timeouts and token expiry. The bridge uses the system's
+// clocks unless a test or benchmark sets a ManualClock, which lets it simulate hours in milliseconds. Durations
+// the bridge only measures, such as those in its performance counters, always come from steady_clock.
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+
+    // Now returns the current monotonic time, by which the bridge computes deadlines
+    virtual std::chrono::steady_clock::time_point Now() = 0;
+    // SystemNow returns the current wall-clock time, by which the bridge judges token expiry
+    virtual std::chrono::system_clock::time_point SystemNow() = 0;
+    // Slice returns how long a caller should block waiting for something due after remaining passes on this
+    // clock. Callers check the clock again after each slice.
+    virtual std::chrono::steady_clock::duration Slice(std::chrono::steady_clock::duration remaining) = 0;
+};
+
+// ManualClock is a Clock that moves only when Advance is called
+class ManualClock : public Clock
+{
+public:
+    // ManualClock starts at the current time, so tokens it judges have realistic expiration times
+    ManualClock();
+
+    std::chrono::steady_clock::time_point Now() override;
+    std::chrono::system_clock::time_point SystemNow() override;
+    std::chrono::steady_clock::duration Slice(std::chrono::steady_clock::duration remaining) override;
+
+    void Advance(std::chrono::steady_clock::duration d);
+
+private:
+    std::mutex mu;
+    std::chrono::steady_clock::time_point now;
+    std::chrono::system_clock::time_point systemNow;
+};
+
+// GetClock returns the clock the bridge uses
+Clock &GetClock();
+
+// SetClock sets the clock the bridge uses. NULL restores the system's clocks. The caller keeps ownership of
+// clock and must restore the system's clocks before destroying it.
+void SetClock(Clock *clock);
+
+// WaitUntil waits on cv until ready returns true or deadline passes on clock. lock must hold cv's mutex. It
+// returns ready's final value.
+template <typename Predicate>
+bool WaitUntil(Clock &clock, std::condition_variable &cv, std::unique_lock<std::mutex> &lock, std::chrono::steady_clock::time_point deadline, Predicate ready)
+{
+    while (!ready())
+    {
+        auto remaining = deadline - clock.Now();
+        if (remaining <= std::chrono::steady_clock::duration::zero())
+        {
+            return false;
+        }
+        cv.wait_for(lock, clock.Slice(remaining));
+    }
+    return true;
+}
+
+// SleepFor blocks the calling thread until d passes on clock
+void SleepFor(Clock &clock, std::chrono::steady_clock::duration d);
@@ -0,0 +1,92 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "log_ring.h"
+#include <algorithm>
+#include <cstring>
+
+LogRing::LogRing(size_t capacity) : cells(new Cell[capacity]), mask(capacity - 1)
+{
+    for (size_t i = 0; i < capacity; i++)
+    {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool LogRing::Push(const char *message, size_t length)
+{
+    Cell *cell;
+    auto pos = enqueuePos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        cell = &cells[pos & mask];
+        auto seq = cell->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0)
+        {
+            // the cell is free; claim it unless another producer got there first
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            // the cell still holds a record from the previous lap, so the ring is full
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    auto n = std::min(length, sizeof(cell->record.message) - 1);
+    memcpy(cell->record.message, message, n);
+    cell->record.message[n] = '\0';
+    cell->record.length = static_cast<uint32_t>(n);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool LogRing::Pop(LogRecord *record)
+{
+    Cell *cell;
+    auto pos = dequeuePos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        cell = &cells[pos & mask];
+        auto seq = cell->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+        if (diff == 0)
+        {
+            if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+    record->length = cell->record.length;
+    memcpy(record->message, cell->record.message, cell->record.length + 1);
+    // mark the cell free for the producer of the next lap
+    cell->sequence.store(pos + mask + 1, std::memory_order_release);
+    return true;
+}
+
+void LogRing::Drop()
+{
+    dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t LogRing::Dropped() const
+{
+    return dropped.load(std::memory_order_relaxed);
+}
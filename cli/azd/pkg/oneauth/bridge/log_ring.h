@@ -0,0 +1,44 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "bridge.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// LogRing is a bounded, lock-free queue of log records with any number of producers and consumers. OneAuth
+// logs from its own threads, so pushing mustn't block them; when the ring is full, Push drops the record
+// and counts it. This is Dmitry Vyukov's bounded MPMC queue: each cell's sequence number tells producers
+// and consumers whether the cell is free for the current lap of the ring.
+class LogRing
+{
+public:
+    // capacity must be a power of 2
+    explicit LogRing(size_t capacity);
+
+    // Push copies message into the ring, truncating it to fit a LogRecord. It returns false when the ring is full.
+    bool Push(const char *message, size_t length);
+    // Pop moves the oldest record into record. It returns false when the ring is empty.
+    bool Pop(LogRecord *record);
+    // Drop counts a record the caller discarded instead of pushing
+    void Drop();
+    // Dropped returns the number of records Push has dropped, plus those counted by Drop
+    uint64_t Dropped() const;
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        LogRecord record;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    const size_t mask;
+    // producers and consumers contend on different positions, so keep those on different cache lines
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) std::atomic<size_t> dequeuePos{0};
+    alignas(64) std::atomic<uint64_t> dropped{0};
+};
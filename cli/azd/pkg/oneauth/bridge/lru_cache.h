@@ -0,0 +1,89 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// LruCache is a small, thread-safe cache of shared objects keyed by string. When full, it evicts
+// the least recently used object. It counts hits and misses so callers can report its hit rate.
+template <typename T>
+class LruCache
+{
+public:
+    explicit LruCache(size_t capacity) : capacity(capacity) {}
+
+    // Get returns the object cached for key, or nullptr if there is none
+    std::shared_ptr<T> Get(const std::string &key)
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = index.find(key);
+        if (it == index.end())
+        {
+            misses++;
+            return nullptr;
+        }
+        hits++;
+        // move the entry to the front of the list, which is ordered from most to least recently used
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->second;
+    }
+
+    void Put(const std::string &key, std::shared_ptr<T> value)
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = index.find(key);
+        if (it != index.end())
+        {
+            it->second->second = std::move(value);
+            entries.splice(entries.begin(), entries, it->second);
+            return;
+        }
+        entries.emplace_front(key, std::move(value));
+        index[key] = entries.begin();
+        if (entries.size() > capacity)
+        {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+
+    void Remove(const std::string &key)
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = index.find(key);
+        if (it != index.end())
+        {
+            entries.erase(it->second);
+            index.erase(it);
+        }
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        entries.clear();
+        index.clear();
+    }
+
+    uint64_t Hits() const { return hits; }
+    uint64_t Misses() const { return misses; }
+
+private:
+    using entry = std::pair<std::string, std::shared_ptr<T>>;
+
+    const size_t capacity;
+    std::list<entry> entries;
+    std::unordered_map<std::string, typename std::list<entry>::iterator> index;
+    std::mutex mu;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+};
@@ -0,0 +1,107 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "pending_auth.h"
+#include "clock.h"
+#include <algorithm>
+
+void PendingAuth::Complete(TokenResult r)
+{
+    std::vector<subscriber> subs;
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        if (result)
+        {
+            return;
+        }
+        result = std::move(r);
+        subs.swap(subscribers);
+    }
+    cv.notify_all();
+    // invoke callbacks without holding the lock because they may call back into the bridge
+    for (const auto &s : subs)
+    {
+        s.callback();
+    }
+}
+
+bool PendingAuth::Done()
+{
+    std::lock_guard<std::mutex> lock(mu);
+    return result.has_value();
+}
+
+uint64_t PendingAuth::Subscribe(std::function<void()> callback)
+{
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        id = nextID++;
+        if (!callback)
+        {
+            return id;
+        }
+        if (!result)
+        {
+            subscribers.push_back(subscriber{id, std::move(callback)});
+            return id;
+        }
+    }
+    callback();
+    return id;
+}
+
+void PendingAuth::Unsubscribe(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(mu);
+    subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(), [id](const subscriber &s)
+                                     { return s.id == id; }),
+                      subscribers.end());
+}
+
+std::optional<TokenResult> PendingAuth::Wait(std::chrono::milliseconds timeout)
+{
+    auto &clock = GetClock();
+    std::unique_lock<std::mutex> lock(mu);
+    WaitUntil(clock, cv, lock, clock.Now() + timeout, [this]
+              { return result.has_value(); });
+    return result;
+}
+
+InflightRequests::InflightRequests(std::chrono::steady_clock::duration maxAge) : maxAge(maxAge) {}
+
+std::shared_ptr<PendingAuth> InflightRequests::find(const std::string &key, std::chrono::steady_clock::time_point now)
+{
+    auto it = flights.find(key);
+    if (it == flights.end())
+    {
+        return nullptr;
+    }
+    auto pending = it->second.pending.lock();
+    if (!pending || pending->Done() || now - it->second.started >= maxAge)
+    {
+        flights.erase(it);
+        return nullptr;
+    }
+    return pending;
+}
+
+std::pair<std::shared_ptr<PendingAuth>, bool> InflightRequests::Join(const std::string &key)
+{
+    auto now = GetClock().Now();
+    std::lock_guard<std::mutex> lock(mu);
+    if (auto pending = find(key, now))
+    {
+        return {pending, false};
+    }
+    auto pending = std::make_shared<PendingAuth>();
+    flights[key] = flight{pending, now};
+    return {pending, true};
+}
+
+std::shared_ptr<PendingAuth> InflightRequests::Find(const std::string &key)
+{
+    auto now = GetClock().Now();
+    std::lock_guard<std::mutex> lock(mu);
+    return find(key, now);
+}
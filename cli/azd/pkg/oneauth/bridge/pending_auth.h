@@ -0,0 +1,86 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// TokenResult is the outcome of an authentication request. Empty strings represent absent values.
+struct TokenResult
+{
+    std::string accountID;
+    std::string error;
+    std::chrono::system_clock::time_point expiresOn;
+    std::string token;
+    // correlationID identifies the OneAuth request that produced the result
+    std::string correlationID;
+};
+
+// PendingAuth is the shared state of an authentication request. OneAuth callbacks hold a shared_ptr to it
+// rather than a reference to a caller's stack, so a callback arriving after the caller stopped waiting is harmless.
+// Any number of callers may wait for the same request; each gets its own copy of the result.
+class PendingAuth
+{
+public:
+    // Complete records the request's result, wakes waiters and invokes subscribed callbacks. Only the first
+    // call has any effect.
+    void Complete(TokenResult result);
+    bool Done();
+    // Subscribe registers a callback to invoke when the request completes and returns an ID for Unsubscribe.
+    // If the request has already completed, Subscribe invokes the callback before returning.
+    uint64_t Subscribe(std::function<void()> callback);
+    void Unsubscribe(uint64_t id);
+    // Wait waits up to timeout for the request to complete and returns its result, or nullopt if it didn't complete
+    std::optional<TokenResult> Wait(std::chrono::milliseconds timeout);
+
+private:
+    struct subscriber
+    {
+        uint64_t id;
+        std::function<void()> callback;
+    };
+
+    std::condition_variable cv;
+    std::mutex mu;
+    uint64_t nextID = 1;
+    std::optional<TokenResult> result;
+    std::vector<subscriber> subscribers;
+};
+
+// InflightRequests coalesces concurrent requests for the same token, so that only one OneAuth acquisition per key
+// is in flight at a time. It doesn't own the requests; a request leaves the set when it completes, when nothing
+// references it any more, or when it has been in flight for longer than maxAge, since OneAuth may never complete it.
+class InflightRequests
+{
+public:
+    InflightRequests(std::chrono::steady_clock::duration maxAge);
+
+    // Join returns the in-flight request for key, if there is one, and false. Otherwise, it returns a new
+    // request and true, in which case the caller must start the request.
+    std::pair<std::shared_ptr<PendingAuth>, bool> Join(const std::string &key);
+    // Find returns the in-flight request for key, or nullptr if there is none
+    std::shared_ptr<PendingAuth> Find(const std::string &key);
+
+private:
+    struct flight
+    {
+        std::weak_ptr<PendingAuth> pending;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    std::shared_ptr<PendingAuth> find(const std::string &key, std::chrono::steady_clock::time_point now);
+
+    std::unordered_map<std::string, flight> flights;
+    std::chrono::steady_clock::duration maxAge;
+    std::mutex mu;
+};
@@ -0,0 +1,413 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "persistent_token_cache.h"
+#include "clock.h"
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <dpapi.h>
+#include <sddl.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char magic[8] = {'A', 'Z', 'D', 'O', 'A', 'T', 'C', '1'};
+    const uint32_t slotCount = 32;
+    // slotSize accommodates the largest access tokens Entra ID issues, after encryption
+    const uint32_t slotSize = 16 * 1024;
+
+    struct fileHeader
+    {
+        char magic[8];
+        uint32_t slotCount;
+        uint32_t slotSize;
+    };
+
+    // slotHeader precedes a slot's sealed entry, which is the entry's key, account ID and token, each followed by
+    // a NUL. An empty slot has expiresOn 0.
+    struct slotHeader
+    {
+        uint64_t keyHash;
+        // expiresOn is the token's expiration in seconds since the Unix epoch
+        int64_t expiresOn;
+        uint32_t length;
+        uint32_t reserved;
+    };
+
+    const size_t fileSize = sizeof(fileHeader) + static_cast<size_t>(slotCount) * slotSize;
+    const size_t slotCapacity = slotSize - sizeof(slotHeader);
+
+    // hashKey returns the 64-bit FNV-1a hash of key
+    uint64_t hashKey(const std::string &key)
+    {
+        uint64_t h = 14695981039346656037ull;
+        for (unsigned char c : key)
+        {
+            h = (h ^ c) * 1099511628211ull;
+        }
+        return h;
+    }
+
+    int64_t unixSeconds(std::chrono::system_clock::time_point t)
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(t.time_since_epoch()).count();
+    }
+
+#if defined(_WIN32)
+    // seal encrypts an entry for the current user
+    bool seal(const std::string &entry, std::string *sealed)
+    {
+        DATA_BLOB in{static_cast<DWORD>(entry.size()), reinterpret_cast<BYTE *>(const_cast<char *>(entry.data()))};
+        DATA_BLOB out{};
+        if (!CryptProtectData(&in, nullptr, nullptr, nullptr, nullptr, CRYPTPROTECT_UI_FORBIDDEN, &out))
+        {
+            return false;
+        }
+        sealed->assign(reinterpret_cast<char *>(out.pbData), out.cbData);
+        LocalFree(out.pbData);
+        return true;
+    }
+
+    bool unseal(const std::string &sealed, std::string *entry)
+    {
+        DATA_BLOB in{static_cast<DWORD>(sealed.size()), reinterpret_cast<BYTE *>(const_cast<char *>(sealed.data()))};
+        DATA_BLOB out{};
+        if (!CryptUnprotectData(&in, nullptr, nullptr, nullptr, nullptr, CRYPTPROTECT_UI_FORBIDDEN, &out))
+        {
+            return false;
+        }
+        entry->assign(reinterpret_cast<char *>(out.pbData), out.cbData);
+        SecureZeroMemory(out.pbData, out.cbData);
+        LocalFree(out.pbData);
+        return true;
+    }
+#else
+    // without DPAPI, entries are protected only by the file's permissions
+    bool seal(const std::string &entry, std::string *sealed)
+    {
+        *sealed = entry;
+        return true;
+    }
+
+    bool unseal(const std::string &sealed, std::string *entry)
+    {
+        *entry = sealed;
+        return true;
+    }
+#endif
+}
+
+#if defined(_WIN32)
+struct PersistentTokenCache::mappedFile
+{
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+    uint8_t *view = nullptr;
+
+    ~mappedFile()
+    {
+        if (view)
+        {
+            UnmapViewOfFile(view);
+        }
+        if (mapping)
+        {
+            CloseHandle(mapping);
+        }
+        if (handle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(handle);
+        }
+    }
+
+    std::string open(const std::string &path)
+    {
+        auto n = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+        std::wstring wide(n, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wide.data(), n);
+        // a new file's protected DACL grants access only to its owner, rather than inheriting its directory's
+        SECURITY_ATTRIBUTES sa{sizeof(sa), nullptr, FALSE};
+        if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(L"D:P(A;;FA;;;OW)", SDDL_REVISION_1, &sa.lpSecurityDescriptor, nullptr))
+        {
+            return "couldn't create a security descriptor for " + path + ": error " + std::to_string(GetLastError());
+        }
+        handle = CreateFileW(wide.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, &sa, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        auto openError = GetLastError();
+        LocalFree(sa.lpSecurityDescriptor);
+        if (handle == INVALID_HANDLE_VALUE)
+        {
+            return "couldn't open " + path + ": error " + std::to_string(openError);
+        }
+        // mapping more than the file's size extends the file
+        mapping = CreateFileMappingW(handle, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(fileSize), nullptr);
+        if (!mapping)
+        {
+            return "couldn't map " + path + ": error " + std::to_string(GetLastError());
+        }
+        view = static_cast<uint8_t *>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, fileSize));
+        if (!view)
+        {
+            return "couldn't map " + path + ": error " + std::to_string(GetLastError());
+        }
+        return "";
+    }
+
+    // lock locks a byte beyond the mapped range, so the lock coordinates processes without restricting access
+    // to the mapping
+    void lock(bool exclusive)
+    {
+        OVERLAPPED o{};
+        o.Offset = MAXDWORD;
+        o.OffsetHigh = MAXLONG;
+        LockFileEx(handle, exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0, 0, 1, 0, &o);
+    }
+
+    void unlock()
+    {
+        OVERLAPPED o{};
+        o.Offset = MAXDWORD;
+        o.OffsetHigh = MAXLONG;
+        UnlockFileEx(handle, 0, 1, 0, &o);
+    }
+};
+#else
+struct PersistentTokenCache::mappedFile
+{
+    int fd = -1;
+    uint8_t *view = nullptr;
+
+    ~mappedFile()
+    {
+        if (view)
+        {
+            munmap(view, fileSize);
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    std::string open(const std::string &path)
+    {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0)
+        {
+            return "couldn't open " + path + ": " + strerror(errno);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            return "couldn't stat " + path + ": " + strerror(errno);
+        }
+        // O_CREAT's mode applies only to a new file, so check an existing file belongs to this user and
+        // restrict it to them
+        if (st.st_uid != geteuid())
+        {
+            return "couldn't open " + path + ": it belongs to another user";
+        }
+        if ((st.st_mode & 0077) != 0 && fchmod(fd, 0600) != 0)
+        {
+            return "couldn't restrict " + path + ": " + strerror(errno);
+        }
+        if (st.st_size < static_cast<off_t>(fileSize) && ftruncate(fd, fileSize) != 0)
+        {
+            return "couldn't size " + path + ": " + strerror(errno);
+        }
+        auto v = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (v == MAP_FAILED)
+        {
+            return "couldn't map " + path + ": " + strerror(errno);
+        }
+        view = static_cast<uint8_t *>(v);
+        return "";
+    }
+
+    void lock(bool exclusive)
+    {
+        flock(fd, exclusive ? LOCK_EX : LOCK_SH);
+    }
+
+    void unlock()
+    {
+        flock(fd, LOCK_UN);
+    }
+};
+#endif
+
+namespace
+{
+    slotHeader *slotAt(uint8_t *view, uint32_t i)
+    {
+        return reinterpret_cast<slotHeader *>(view + sizeof(fileHeader) + static_cast<size_t>(i) * slotSize);
+    }
+}
+
+PersistentTokenCache::PersistentTokenCache() = default;
+
+PersistentTokenCache::~PersistentTokenCache() = default;
+
+std::string PersistentTokenCache::Open(const std::string &path, const std::string &clientID)
+{
+    auto f = std::make_unique<mappedFile>();
+    auto error = f->open(path);
+    if (!error.empty())
+    {
+        return error;
+    }
+    f->lock(true);
+    auto header = reinterpret_cast<fileHeader *>(f->view);
+    if (memcmp(header->magic, magic, sizeof(magic)) != 0 || header->slotCount != slotCount || header->slotSize != slotSize)
+    {
+        // the file is new or another version of the bridge wrote it
+        memset(f->view, 0, fileSize);
+        memcpy(header->magic, magic, sizeof(magic));
+        header->slotCount = slotCount;
+        header->slotSize = slotSize;
+    }
+    f->unlock();
+
+    std::lock_guard<std::mutex> lock(mu);
+    file = std::move(f);
+    this->clientID = clientID;
+    return "";
+}
+
+void PersistentTokenCache::Close()
+{
+    std::lock_guard<std::mutex> lock(mu);
+    file.reset();
+}
+
+bool PersistentTokenCache::IsOpen()
+{
+    std::lock_guard<std::mutex> lock(mu);
+    return file != nullptr;
+}
+
+std::string PersistentTokenCache::key(const std::string &authority, const std::string &scope, const std::string &accountID) const
+{
+    return clientID + '\n' + tokenKey(authority, scope, accountID);
+}
+
+std::shared_ptr<const CachedToken> PersistentTokenCache::Get(const std::string &authority, const std::string &scope, const std::string &accountID)
+{
+    std::lock_guard<std::mutex> lock(mu);
+    if (!file || accountID.empty() || expirySkew.count() < 0)
+    {
+        return nullptr;
+    }
+    auto k = key(authority, scope, accountID);
+    auto hash = hashKey(k);
+    auto threshold = unixSeconds(GetClock().SystemNow() + expirySkew);
+    std::vector<std::pair<std::string, int64_t>> candidates;
+    file->lock(false);
+    for (uint32_t i = 0; i < slotCount; i++)
+    {
+        auto s = slotAt(file->view, i);
+        if (s->keyHash == hash && s->expiresOn > threshold && s->length <= slotCapacity)
+        {
+            candidates.emplace_back(std::string(reinterpret_cast<const char *>(s + 1), s->length), s->expiresOn);
+        }
+    }
+    file->unlock();
+
+    // the entry is "key\0accountID\0token\0"; its key distinguishes entries whose keys have the same hash
+    std::string entry;
+    std::string::size_type keyEnd = 0, accountEnd = 0;
+    int64_t expiresOn = 0;
+    bool found = false;
+    for (const auto &candidate : candidates)
+    {
+        entry.clear();
+        if (!unseal(candidate.first, &entry))
+        {
+            continue;
+        }
+        keyEnd = entry.find('\0');
+        accountEnd = keyEnd == std::string::npos ? keyEnd : entry.find('\0', keyEnd + 1);
+        if (accountEnd != std::string::npos && entry.compare(0, keyEnd, k) == 0 && entry.back() == '\0')
+        {
+            expiresOn = candidate.second;
+            found = true;
+            break;
+        }
+    }
+    if (!found)
+    {
+        return nullptr;
+    }
+    auto token = std::make_shared<CachedToken>();
+    token->accountID = entry.substr(keyEnd + 1, accountEnd - keyEnd - 1);
+    token->token = entry.substr(accountEnd + 1, entry.size() - accountEnd - 2);
+    token->expiresOn = std::chrono::system_clock::time_point(std::chrono::seconds(expiresOn));
+    return token;
+}
+
+void PersistentTokenCache::Put(const std::string &authority, const std::string &scope, const CachedToken &token)
+{
+    std::lock_guard<std::mutex> lock(mu);
+    if (!file || token.accountID.empty() || token.token.empty())
+    {
+        return;
+    }
+    auto k = key(authority, scope, token.accountID);
+    auto entry = k + '\0' + token.accountID + '\0' + token.token + '\0';
+    std::string sealed;
+    if (!seal(entry, &sealed) || sealed.size() > slotCapacity)
+    {
+        return;
+    }
+    auto hash = hashKey(k);
+    file->lock(true);
+    // replace this key's entry if there is one, otherwise an empty slot or the entry expiring soonest
+    slotHeader *target = nullptr;
+    for (uint32_t i = 0; i < slotCount; i++)
+    {
+        auto s = slotAt(file->view, i);
+        if (s->keyHash == hash)
+        {
+            target = s;
+            break;
+        }
+        if (!target || s->expiresOn < target->expiresOn)
+        {
+            target = s;
+        }
+    }
+    memcpy(target + 1, sealed.data(), sealed.size());
+    target->keyHash = hash;
+    target->expiresOn = unixSeconds(token.expiresOn);
+    target->length = static_cast<uint32_t>(sealed.size());
+    file->unlock();
+}
+
+void PersistentTokenCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mu);
+    if (!file)
+    {
+        return;
+    }
+    file->lock(true);
+    memset(file->view + sizeof(fileHeader), 0, fileSize - sizeof(fileHeader));
+    file->unlock();
+}
+
+void PersistentTokenCache::SetExpirySkew(std::chrono::seconds skew)
+{
+    std::lock_guard<std::mutex> lock(mu);
+    expirySkew = skew;
+}
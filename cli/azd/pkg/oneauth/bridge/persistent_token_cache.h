@@ -0,0 +1,48 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "token_cache.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// PersistentTokenCache keeps access tokens in a memory-mapped file every process of the user shares, so a new
+// process can return a token an earlier process acquired without starting the backend. Entries are keyed like
+// TokenCache's plus the client ID. On Windows, each entry's account ID and token are encrypted for the user with
+// DPAPI; elsewhere, only the file's permissions protect them.
+//
+// The file has a fixed number of fixed-size slots. When every slot is in use, Put replaces the entry expiring
+// soonest, and Put ignores tokens too large for a slot.
+class PersistentTokenCache
+{
+public:
+    PersistentTokenCache();
+    ~PersistentTokenCache();
+
+    // Open maps the cache file at path for the given client ID's tokens, creating the file if necessary, and
+    // closes any file already open. It returns an error message, or "" on success.
+    std::string Open(const std::string &path, const std::string &clientID);
+    void Close();
+    bool IsOpen();
+
+    // Get returns a cached token that won't expire within the skew, or nullptr if there's none or no file is open
+    std::shared_ptr<const CachedToken> Get(const std::string &authority, const std::string &scope, const std::string &accountID);
+    void Put(const std::string &authority, const std::string &scope, const CachedToken &token);
+    // Clear removes every entry from the file, for every process
+    void Clear();
+    // SetExpirySkew is TokenCache::SetExpirySkew for the file. A negative skew disables the cache.
+    void SetExpirySkew(std::chrono::seconds skew);
+
+private:
+    struct mappedFile;
+
+    std::string key(const std::string &authority, const std::string &scope, const std::string &accountID) const;
+
+    std::mutex mu;
+    std::unique_ptr<mappedFile> file;
+    std::string clientID;
+    std::chrono::seconds expirySkew = std::chrono::minutes(5);
+};
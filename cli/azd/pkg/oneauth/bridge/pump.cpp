@@ -0,0 +1,35 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "pump.h"
+#include "clock.h"
+
+PumpResult Pump(EventSource &source, std::chrono::steady_clock::time_point deadline, const std::function<bool()> &done, Histogram *dispatching)
+{
+    auto &clock = GetClock();
+    while (!done())
+    {
+        auto now = clock.Now();
+        if (now >= deadline)
+        {
+            return PumpResult::DeadlinePassed;
+        }
+        // round up so the final wait doesn't return just before the deadline and spin
+        auto timeout = std::chrono::ceil<std::chrono::milliseconds>(clock.Slice(deadline - now));
+        auto event = source.Wait(timeout);
+        if (event == PumpEvent::Failed)
+        {
+            return PumpResult::Failed;
+        }
+        if (event == PumpEvent::Message)
+        {
+            auto start = std::chrono::steady_clock::now();
+            source.Dispatch();
+            if (dispatching)
+            {
+                dispatching->Since(start);
+            }
+        }
+    }
+    return PumpResult::Done;
+}
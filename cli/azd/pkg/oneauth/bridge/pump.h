@@ -0,0 +1,49 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "stats.h"
+#include <chrono>
+#include <functional>
+
+// PumpEvent is the reason EventSource::Wait returned
+enum class PumpEvent
+{
+    // a message arrived and the pump should dispatch it
+    Message,
+    // Signal was called
+    Signaled,
+    Timeout,
+    // waiting failed and will fail again, so the pump should stop
+    Failed,
+};
+
+// PumpResult is the reason Pump returned
+enum class PumpResult
+{
+    // done returned true
+    Done,
+    DeadlinePassed,
+    // the event source's Wait failed
+    Failed,
+};
+
+// EventSource is what a message pump waits on. On Windows it's the calling thread's message queue.
+class EventSource
+{
+public:
+    virtual ~EventSource() = default;
+
+    // Wait blocks until a message arrives, Signal is called or timeout passes, whichever happens first
+    virtual PumpEvent Wait(std::chrono::milliseconds timeout) = 0;
+    // Dispatch dispatches messages that have arrived. It doesn't block.
+    virtual void Dispatch() = 0;
+    // Signal wakes Wait. It may be called from any thread, before or during Wait.
+    virtual void Signal() = 0;
+};
+
+// Pump dispatches messages from source until done returns true, deadline passes or source fails. It checks done
+// before waiting and after every event, so callers should Signal source when done's value may have changed. When
+// dispatching isn't NULL, Pump records in it the time each dispatch takes.
+PumpResult Pump(EventSource &source, std::chrono::steady_clock::time_point deadline, const std::function<bool()> &done, Histogram *dispatching = nullptr);
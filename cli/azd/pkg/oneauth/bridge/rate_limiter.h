@@ -0,0 +1,44 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// RateLimiter allows approximately a fixed number of events per second. It's lock-free, so callers on
+// threads that mustn't block can use it; concurrent callers at the turn of a second may slightly exceed
+// the limit.
+class RateLimiter
+{
+public:
+    // SetLimit sets the number of events allowed per second. 0 means no limit, which is the default.
+    void SetLimit(uint32_t perSecond)
+    {
+        limit.store(perSecond, std::memory_order_relaxed);
+    }
+
+    // Allow returns true when an event happening now is within the limit
+    bool Allow(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now())
+    {
+        auto l = limit.load(std::memory_order_relaxed);
+        if (l == 0)
+        {
+            return true;
+        }
+        auto second = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+        auto w = window.load(std::memory_order_relaxed);
+        if (second != w && window.compare_exchange_strong(w, second, std::memory_order_relaxed))
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+        return count.fetch_add(1, std::memory_order_relaxed) < l;
+    }
+
+private:
+    std::atomic<uint32_t> limit{0};
+    // window is the second in which count events have happened
+    std::atomic<int64_t> window{0};
+    std::atomic<uint32_t> count{0};
+};
@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "scheduler.h"
+#include "clock.h"
+
+Scheduler::~Scheduler()
+{
+    Stop();
+}
+
+void Scheduler::After(std::chrono::steady_clock::duration delay, std::function<void()> f)
+{
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        tasks.emplace(std::make_pair(GetClock().Now() + delay, next++), std::move(f));
+        if (!thread.joinable())
+        {
+            stopped = false;
+            thread = std::thread(&Scheduler::run, this);
+        }
+    }
+    cv.notify_one();
+}
+
+void Scheduler::Stop()
+{
+    std::thread t;
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        stopped = true;
+        tasks.clear();
+        t = std::move(thread);
+    }
+    cv.notify_all();
+    if (t.joinable())
+    {
+        t.join();
+    }
+}
+
+void Scheduler::run()
+{
+    std::unique_lock<std::mutex> lock(mu);
+    while (!stopped)
+    {
+        if (tasks.empty())
+        {
+            cv.wait(lock);
+            continue;
+        }
+        auto &clock = GetClock();
+        auto due = tasks.begin()->first.first;
+        auto now = clock.Now();
+        if (now < due)
+        {
+            cv.wait_for(lock, clock.Slice(due - now));
+            continue;
+        }
+        auto f = std::move(tasks.begin()->second);
+        tasks.erase(tasks.begin());
+        lock.unlock();
+        f();
+        lock.lock();
+    }
+}
@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// Scheduler calls functions after a delay on a thread it owns, as an authentication service calls back on its
+// own threads. Delays pass on the bridge's Clock. The thread starts with the first function.
+class Scheduler
+{
+public:
+    ~Scheduler();
+
+    void After(std::chrono::steady_clock::duration delay, std::function<void()> f);
+    // Stop discards scheduled functions and waits for the running function, if any, to return
+    void Stop();
+
+private:
+    void run();
+
+    std::condition_variable cv;
+    std::mutex mu;
+    uint64_t next = 0;
+    bool stopped = false;
+    // tasks are ordered by due time and then by a sequence number, which keeps functions due at the same
+    // time in order
+    std::map<std::pair<std::chrono::steady_clock::time_point, uint64_t>, std::function<void()>> tasks;
+    std::thread thread;
+};
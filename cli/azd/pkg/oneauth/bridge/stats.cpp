@@ -0,0 +1,51 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "stats.h"
+
+void Histogram::Record(std::chrono::steady_clock::duration duration)
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    if (us < 0)
+    {
+        us = 0;
+    }
+    // bucket 0 counts durations under 1ms; bucket i counts durations in [2^(i-1), 2^i) ms
+    auto ms = static_cast<uint64_t>(us / 1000);
+    size_t i = 0;
+    while (ms && i < buckets.size() - 1)
+    {
+        ms >>= 1;
+        i++;
+    }
+    buckets[i].fetch_add(1, std::memory_order_relaxed);
+    totalMicroseconds.fetch_add(static_cast<uint64_t>(us), std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Histogram::Since(std::chrono::steady_clock::time_point start)
+{
+    Record(std::chrono::steady_clock::now() - start);
+}
+
+void Histogram::Read(LatencyHistogram *histogram) const
+{
+    histogram->count = count.load(std::memory_order_relaxed);
+    histogram->totalMicroseconds = totalMicroseconds.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < buckets.size(); i++)
+    {
+        histogram->buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+}
+
+void Stats::Read(BridgeStats *stats) const
+{
+    startup.Read(&stats->startup);
+    readAccount.Read(&stats->readAccount);
+    silentAcquisition.Read(&stats->silentAcquisition);
+    interactiveSignIn.Read(&stats->interactiveSignIn);
+    pumpIterations.Read(&stats->pumpIterations);
+    logout.Read(&stats->logout);
+    stats->timeouts = timeouts.load(std::memory_order_relaxed);
+    stats->errors = errors.load(std::memory_order_relaxed);
+}
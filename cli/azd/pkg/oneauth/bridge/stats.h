@@ -0,0 +1,55 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include "bridge.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Histogram counts durations in the power-of-2 millisecond buckets of a LatencyHistogram. It's lock-free,
+// so OneAuth's threads can record durations without contending with readers.
+class Histogram
+{
+public:
+    void Record(std::chrono::steady_clock::duration duration);
+    // Since records the time elapsed since start
+    void Since(std::chrono::steady_clock::time_point start);
+    void Read(LatencyHistogram *histogram) const;
+
+private:
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> totalMicroseconds{0};
+    std::array<std::atomic<uint64_t>, sizeof(LatencyHistogram::buckets) / sizeof(uint64_t)> buckets{};
+};
+
+// Stopwatch records the duration of a scope in a Histogram
+class Stopwatch
+{
+public:
+    explicit Stopwatch(Histogram &histogram) : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+    ~Stopwatch() { histogram.Since(start); }
+    Stopwatch(const Stopwatch &) = delete;
+    Stopwatch &operator=(const Stopwatch &) = delete;
+
+private:
+    Histogram &histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Stats are the bridge's performance counters, as returned by GetBridgeStats
+struct Stats
+{
+    Histogram startup;
+    Histogram readAccount;
+    Histogram silentAcquisition;
+    Histogram interactiveSignIn;
+    Histogram pumpIterations;
+    Histogram logout;
+    std::atomic<uint64_t> timeouts{0};
+    std::atomic<uint64_t> errors{0};
+
+    void Read(BridgeStats *stats) const;
+};
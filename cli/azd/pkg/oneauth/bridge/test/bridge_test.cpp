@@ -0,0 +1,568 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "bridge.h"
+#include "fake_backend.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <catch2/catch.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const char *authority = "https://login.microsoftonline.com/organizations";
+    const char *scope = "https://management.azure.com//.default";
+
+    std::string str(const char *s)
+    {
+        return s ? s : "";
+    }
+
+    // result is a PackedAuthResult's strings
+    struct result
+    {
+        std::string accountID;
+        std::string token;
+        std::string error;
+        std::string correlationID;
+    };
+
+    result unpack(PackedAuthResult *packed)
+    {
+        CHECK(packed != nullptr);
+        if (!packed)
+        {
+            return result();
+        }
+        result r{str(packed->accountID), str(packed->token), str(packed->error), str(packed->correlationID)};
+        FreePackedAuthResult(packed);
+        return r;
+    }
+
+    result authenticate(const char *accountID, bool allowPrompt)
+    {
+        return unpack(AuthenticatePacked(authority, scope, accountID, allowPrompt));
+    }
+
+    AuthenticateRequest request(const char *accountID, bool allowPrompt)
+    {
+        AuthenticateRequest r{};
+        r.size = sizeof(r);
+        r.authority = authority;
+        r.authorityLength = static_cast<uint32_t>(strlen(authority));
+        r.scope = scope;
+        r.scopeLength = static_cast<uint32_t>(strlen(scope));
+        r.accountID = accountID;
+        r.accountIDLength = static_cast<uint32_t>(strlen(accountID));
+        r.allowPrompt = allowPrompt;
+        return r;
+    }
+
+    FakeBackendCounts counts()
+    {
+        FakeBackendCounts c{};
+        GetFakeBackendCounts(&c);
+        return c;
+    }
+
+    // countCompletion is an AuthCompletion whose context is a std::atomic<int> counting its calls
+    void countCompletion(uintptr_t context)
+    {
+        (*reinterpret_cast<std::atomic<int> *>(context))++;
+    }
+
+    BridgeStats stats()
+    {
+        BridgeStats s{};
+        s.size = sizeof(s);
+        GetBridgeStats(&s);
+        return s;
+    }
+
+    // BridgeTest starts the bridge with the fake backend's default options
+    class BridgeTest
+    {
+    public:
+        BridgeTest()
+        {
+            Configure(FakeBackendOptions{});
+            ConfigureTokenCache(300);
+            ConfigureTokenRefresh(0);
+            SetLogOptions(3, 0);
+            auto err = Startup("04b07795-8ddb-461a-bbee-02f9e1bf7b46", "com.microsoft.azd", "1.0.0", nullptr);
+            REQUIRE(err == nullptr);
+        }
+
+        ~BridgeTest()
+        {
+            Shutdown();
+            ConfigureFakeBackend(nullptr);
+            LogRecord records[64];
+            while (DrainLogs(records, 64, nullptr) > 0)
+            {
+            }
+        }
+
+        void Configure(const FakeBackendOptions &options)
+        {
+            ConfigureFakeBackend(&options);
+        }
+    };
+}
+
+TEST_CASE_METHOD(BridgeTest, "CachesTokens", "[bridge]")
+{
+    auto first = authenticate("account", false);
+    REQUIRE(first.error == "");
+    CHECK(first.accountID == "account");
+    CHECK(first.token != "");
+    CHECK(first.correlationID != "");
+
+    auto second = authenticate("account", false);
+    CHECK(first.token == second.token);
+    // the cached token didn't come from the backend, so it has no correlation ID
+    CHECK(second.correlationID == "");
+    CHECK(counts().acquireSilently == 1u);
+    CHECK(counts().readAccount == 1u);
+}
+
+TEST_CASE_METHOD(BridgeTest, "ShortLivedTokensAreNotCached", "[bridge]")
+{
+    FakeBackendOptions options{};
+    // shorter than the cache's expiry skew
+    options.tokenLifetimeSeconds = 60;
+    Configure(options);
+
+    auto first = authenticate("account", false);
+    auto second = authenticate("account", false);
+    REQUIRE(second.error == "");
+    CHECK(first.token != second.token);
+    CHECK(counts().acquireSilently == 2u);
+    // the account is cached regardless
+    CHECK(counts().readAccount == 1u);
+}
+
+TEST_CASE_METHOD(BridgeTest, "InteractiveSignIn", "[bridge]")
+{
+    FakeBackendOptions options{};
+    options.signInInteractively.latencyMilliseconds = 20;
+    Configure(options);
+
+    PackedAuthResult *packed = AuthenticatePacked(authority, scope, "", true);
+    REQUIRE(packed != nullptr);
+    CHECK(packed->pumpMicroseconds > 0u);
+    auto r = unpack(packed);
+    CHECK(r.error == "");
+    CHECK(r.accountID == "fake-account");
+    CHECK(counts().signInInteractively == 1u);
+}
+
+TEST_CASE_METHOD(BridgeTest, "InteractionRequired", "[bridge]")
+{
+    auto r = authenticate("", false);
+    CHECK(r.error.find("azd auth login") != std::string::npos);
+    CHECK(counts().acquireSilently == 0u);
+    CHECK(counts().signInInteractively == 0u);
+}
+
+TEST_CASE_METHOD(BridgeTest, "Failure", "[bridge]")
+{
+    FakeBackendOptions options{};
+    options.acquireSilently.fail = true;
+    Configure(options);
+    auto before = stats().errors;
+
+    auto r = authenticate("account", false);
+    CHECK(r.error == "fake AcquireTokenSilently failure");
+    CHECK(r.token == "");
+    CHECK(before + 1 == stats().errors);
+}
+
+TEST_CASE_METHOD(BridgeTest, "Deadline", "[bridge]")
+{
+    FakeBackendOptions options{};
+    options.acquireSilently.dropCallback = true;
+    Configure(options);
+    auto before = stats().timeouts;
+
+    auto req = request("account", false);
+    auto deadline = std::chrono::system_clock::now() + std::chrono::milliseconds(100);
+    req.deadline = std::chrono::duration_cast<std::chrono::milliseconds>(deadline.time_since_epoch()).count();
+    auto start = std::chrono::steady_clock::now();
+    auto r = unpack(AuthenticateEx(&req));
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+    CHECK(r.error == "timed out waiting for silent authentication");
+    CHECK(before + 1 == stats().timeouts);
+}
+
+TEST_CASE_METHOD(BridgeTest, "Cancel", "[bridge]")
+{
+    FakeBackendOptions options{};
+    options.signInInteractively.dropCallback = true;
+    Configure(options);
+
+    auto req = request("", true);
+    req.cancellationID = 42;
+    std::thread canceller(
+        []
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            CancelAuthenticate(42);
+        });
+    auto start = std::chrono::steady_clock::now();
+    auto r = unpack(AuthenticateEx(&req));
+    canceller.join();
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+    CHECK(r.error == "authentication cancelled");
+}
+
+TEST_CASE_METHOD(BridgeTest, "CoalescesConcurrentRequests", "[bridge]")
+{
+    FakeBackendOptions options{};
+    options.acquireSilently.latencyMilliseconds = 100;
+    Configure(options);
+
+    std::vector<AuthRequest *> requests;
+    for (int i = 0; i < 4; i++)
+    {
+        requests.push_back(AuthenticateAsync(authority, scope, "account", nullptr, 0));
+    }
+    std::string token;
+    for (auto request : requests)
+    {
+        auto r = unpack(WaitAuthRequestPacked(request, 5000));
+        CHECK(r.error == "");
+        if (token.empty())
+        {
+            token = r.token;
+        }
+        CHECK(token == r.token);
+        FreeAuthRequest(request);
+    }
+    CHECK(counts().acquireSilently == 1u);
+}
+
+TEST_CASE_METHOD(BridgeTest, "AuthCompletion", "[bridge]")
+{
+    FakeBackendOptions options{};
+    options.acquireSilently.latencyMilliseconds = 50;
+    Configure(options);
+
+    std::atomic<int> calls{0};
+    auto request = AuthenticateAsync(authority, scope, "account", countCompletion, reinterpret_cast<uintptr_t>(&calls));
+    auto r = unpack(WaitAuthRequestPacked(request, 5000));
+    CHECK(r.error == "");
+    // the callback may run just after the result is ready
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (calls.load() == 0 && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(calls.load() == 1);
+    FreeAuthRequest(request);
+    CHECK(calls.load() == 1);
+}
+
+TEST_CASE_METHOD(BridgeTest, "AuthCompletion Synchronous", "[bridge]")
+{
+    // without an account ID the request completes inside AuthenticateAsync
+    std::atomic<int> calls{0};
+    auto request = AuthenticateAsync(authority, scope, "", countCompletion, reinterpret_cast<uintptr_t>(&calls));
+    CHECK(calls.load() == 1);
+    CHECK(PollAuthRequest(request));
+    auto r = unpack(WaitAuthRequestPacked(request, 0));
+    CHECK(r.error.find("azd auth login") != std::string::npos);
+    FreeAuthRequest(request);
+    CHECK(calls.load() == 1);
+}
+
+TEST_CASE_METHOD(BridgeTest, "AuthCompletion After Free", "[bridge]")
+{
+    FakeBackendOptions options{};
+    options.acquireSilently.latencyMilliseconds = 100;
+    Configure(options);
+
+    std::atomic<int> calls{0};
+    auto request = AuthenticateAsync(authority, scope, "account", countCompletion, reinterpret_cast<uintptr_t>(&calls));
+    FreeAuthRequest(request);
+    // a second request for the same token shares the first's pending state, so its completion shows the first's has run
+    std::atomic<int> secondCalls{0};
+    auto second = AuthenticateAsync(authority, scope, "account", countCompletion, reinterpret_cast<uintptr_t>(&secondCalls));
+    auto r = unpack(WaitAuthRequestPacked(second, 5000));
+    CHECK(r.error == "");
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (secondCalls.load() == 0 && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    FreeAuthRequest(second);
+    CHECK(secondCalls.load() == 1);
+    CHECK(calls.load() == 0);
+    CHECK(counts().acquireSilently == 1u);
+}
+
+TEST_CASE_METHOD(BridgeTest, "AuthenticateMany", "[bridge]")
+{
+    TokenRequest requests[] = {{authority, "a"}, {authority, "b"}, {authority, "a"}};
+    auto results = AuthenticateMany(requests, 3, "account");
+    REQUIRE(results != nullptr);
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK(results[i].errorDescription == nullptr);
+        CHECK(results[i].token != nullptr);
+    }
+    FreeWrappedAuthResults(results, 3);
+    CHECK(counts().readAccount == 1u);
+}
+
+TEST_CASE_METHOD(BridgeTest, "Logs", "[bridge]")
+{
+    authenticate("account", false);
+    LogRecord records[64];
+    auto n = DrainLogs(records, 64, nullptr);
+    REQUIRE(n > 0);
+    CHECK(strncmp(records[0].message, "fake backend:", strlen("fake backend:")) == 0);
+
+    SetLogOptions(0, 0);
+    Logout();
+    CHECK(DrainLogs(records, 64, nullptr) == 0);
+}
+
+TEST_CASE_METHOD(BridgeTest, "Logout", "[bridge]")
+{
+    authenticate("account", false);
+    Logout();
+    CHECK(counts().signOut == 1u);
+    // Logout clears the token cache
+    authenticate("account", false);
+    CHECK(counts().acquireSilently == 2u);
+}
+
+TEST_CASE("BridgeStartup Failure", "[BridgeStartup]")
+{
+    FakeBackendOptions options{};
+    options.startup.fail = true;
+    ConfigureFakeBackend(&options);
+    auto err = Startup("client", "com.microsoft.azd", "1.0.0", nullptr);
+    REQUIRE(err != nullptr);
+    CHECK(std::string(err->message) == "fake startup failure");
+    FreeWrappedError(err);
+    ConfigureFakeBackend(nullptr);
+}
+
+TEST_CASE("StartupAsync", "[StartupAsync]")
+{
+    FakeBackendOptions options{};
+    options.startup.latencyMilliseconds = 50;
+    ConfigureFakeBackend(&options);
+    auto started = StartupAsync("client", "com.microsoft.azd", "1.0.0", nullptr, nullptr, 0);
+    REQUIRE(started != nullptr);
+    // authentication waits for the startup to finish
+    auto r = authenticate("account", false);
+    CHECK(r.error == "");
+    CHECK(r.token != "");
+    CHECK(PollAuthRequest(started));
+    CHECK(unpack(WaitAuthRequestPacked(started, 0)).error == "");
+    FreeAuthRequest(started);
+    CHECK(counts().startup == 1u);
+    Shutdown();
+    // the backend shut down on the worker thread that started it
+    CHECK(counts().shutdown == 1u);
+    CHECK(counts().foreignShutdowns == 0u);
+    ConfigureFakeBackend(nullptr);
+}
+
+TEST_CASE("Warmup", "[StartupAsync]")
+{
+    const char *armScope = "https://management.azure.com/";
+    FakeBackendOptions options{};
+    options.startup.latencyMilliseconds = 20;
+    ConfigureFakeBackend(&options);
+    auto started = StartupAsync("client", "com.microsoft.azd", "1.0.0", nullptr, nullptr, 0);
+    Warmup(authority, nullptr, "account");
+    // wait for the warmup to cache the token
+    auto cached = request("account", false);
+    cached.scope = armScope;
+    cached.scopeLength = static_cast<uint32_t>(strlen(armScope));
+    cached.cacheOnly = true;
+    result r;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((r = unpack(AuthenticateEx(&cached))).error != "" && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    REQUIRE(r.error == "");
+    CHECK(r.token != "");
+    CHECK(counts().acquireSilently == 1u);
+
+    // neither authentication nor another warmup calls the backend again
+    CHECK(unpack(AuthenticatePacked(authority, armScope, "account", false)).token == r.token);
+    Warmup(authority, armScope, "account");
+    CHECK(unpack(AuthenticateEx(&cached)).token == r.token);
+    CHECK(counts().acquireSilently == 1u);
+    CHECK(counts().readAccount == 1u);
+    FreeAuthRequest(started);
+    Shutdown();
+    ConfigureFakeBackend(nullptr);
+}
+
+TEST_CASE("StartupAsync Failure", "[StartupAsync]")
+{
+    FakeBackendOptions options{};
+    options.startup.fail = true;
+    ConfigureFakeBackend(&options);
+    auto started = StartupAsync("client", "com.microsoft.azd", "1.0.0", nullptr, nullptr, 0);
+    CHECK(authenticate("account", false).error == "fake startup failure");
+    CHECK(unpack(WaitAuthRequestPacked(started, 1000)).error == "fake startup failure");
+    FreeAuthRequest(started);
+    CHECK(counts().acquireSilently == 0u);
+    Shutdown();
+
+    // Startup recovers from the failure
+    ConfigureFakeBackend(nullptr);
+    REQUIRE(Startup("client", "com.microsoft.azd", "1.0.0", nullptr) == nullptr);
+    CHECK(authenticate("account", false).error == "");
+    Shutdown();
+    CHECK(counts().foreignShutdowns == 0u);
+}
+
+TEST_CASE("BridgeBuildId", "[BridgeBuildId]")
+{
+    std::string id = GetBridgeBuildId();
+    CHECK(id.size() == 32);
+    CHECK(id.find_first_not_of("0123456789abcdef") == std::string::npos);
+    CHECK(std::string(GetBridgeBuildId()) == id);
+}
+
+TEST_CASE("BridgeFunctions", "[BridgeFunctions]")
+{
+    BridgeFunctions functions{};
+    functions.size = sizeof(functions) - 1;
+    GetBridgeFunctions(&functions);
+    CHECK(functions.shutdown == nullptr);
+
+    functions.size = sizeof(functions);
+    GetBridgeFunctions(&functions);
+    CHECK(functions.authenticateEx == AuthenticateEx);
+    CHECK(functions.shutdown == Shutdown);
+    CHECK(std::string(functions.getBridgeBuildId()) == GetBridgeBuildId());
+}
+
+TEST_CASE("TokenCacheFile", "[TokenCacheFile]")
+{
+    auto path = (std::filesystem::temp_directory_path() / "bridge_test.tokens").string();
+    std::filesystem::remove(path);
+    REQUIRE(OpenTokenCacheFile(path.c_str(), "client") == nullptr);
+    ConfigureFakeBackend(nullptr);
+    REQUIRE(Startup("client", "com.microsoft.azd", "1.0.0", nullptr) == nullptr);
+    auto acquired = authenticate("account", false);
+    REQUIRE(acquired.error == "");
+    Shutdown();
+
+    // a new process finds the token in the file without starting the bridge
+    ConfigureFakeBackend(nullptr);
+    auto r = request("account", false);
+    r.cacheOnly = true;
+    auto cached = unpack(AuthenticateEx(&r));
+    CHECK(cached.error == "");
+    CHECK(cached.token == acquired.token);
+    CHECK(cached.correlationID == "");
+    r = request("other", false);
+    r.cacheOnly = true;
+    CHECK(unpack(AuthenticateEx(&r)).error == "no cached token");
+    CHECK(counts().startup == 0u);
+    CHECK(counts().acquireSilently == 0u);
+
+    // a started bridge finds the token in the file too
+    REQUIRE(Startup("client", "com.microsoft.azd", "1.0.0", nullptr) == nullptr);
+    CHECK(authenticate("account", false).token == acquired.token);
+    CHECK(counts().acquireSilently == 0u);
+    Logout();
+    Shutdown();
+    r = request("account", false);
+    r.cacheOnly = true;
+    CHECK(unpack(AuthenticateEx(&r)).error == "no cached token");
+
+    REQUIRE(OpenTokenCacheFile(nullptr, nullptr) == nullptr);
+    ConfigureFakeBackend(nullptr);
+    std::filesystem::remove(path);
+}
+
+// waitAdvancing advances the manual clock by step until f is ready, since the bridge may not have computed its
+// deadlines when the test first advances the clock
+template <typename T>
+T waitAdvancing(std::future<T> &f, int64_t stepMilliseconds)
+{
+    while (f.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready)
+    {
+        AdvanceClock(stepMilliseconds);
+    }
+    return f.get();
+}
+
+TEST_CASE_METHOD(BridgeTest, "ManualClockPhaseTimeout", "[bridge]")
+{
+    UseManualClock(true);
+    FakeBackendOptions options{};
+    options.acquireSilently.dropCallback = true;
+    Configure(options);
+    auto before = stats().timeouts;
+
+    auto start = std::chrono::steady_clock::now();
+    auto f = std::async(std::launch::async, []
+                        { return authenticate("account", false); });
+    auto r = waitAdvancing(f, 5000);
+    UseManualClock(false);
+    // the silent phase times out after 60 simulated seconds, then the request needs interaction
+    CHECK(r.error.find("azd auth login") != std::string::npos);
+    CHECK(stats().timeouts == before + 1);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+}
+
+TEST_CASE_METHOD(BridgeTest, "ManualClockTokenExpiry", "[bridge]")
+{
+    UseManualClock(true);
+    auto first = authenticate("account", false);
+    AdvanceClock(50 * 60 * 1000);
+    auto second = authenticate("account", false);
+    // tokens last an hour and the cache's skew is 5 minutes
+    AdvanceClock(6 * 60 * 1000);
+    auto third = authenticate("account", false);
+    UseManualClock(false);
+
+    CHECK(first.token == second.token);
+    CHECK(third.token != first.token);
+    CHECK(counts().acquireSilently == 2u);
+}
+
+TEST_CASE_METHOD(BridgeTest, "ManualClockLatency", "[bridge]")
+{
+    UseManualClock(true);
+    FakeBackendOptions options{};
+    options.acquireSilently.latencyMilliseconds = 3600 * 1000;
+    Configure(options);
+
+    auto request = AuthenticateAsync(authority, scope, "account", nullptr, 0);
+    AdvanceClock(59 * 60 * 1000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK_FALSE(PollAuthRequest(request));
+
+    AdvanceClock(60 * 1000);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!PollAuthRequest(request) && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    UseManualClock(false);
+    auto r = unpack(WaitAuthRequestPacked(request, 0));
+    FreeAuthRequest(request);
+    CHECK(r.error == "");
+    CHECK(r.token != "");
+}
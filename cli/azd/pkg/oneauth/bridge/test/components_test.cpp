@@ -0,0 +1,541 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "backend_trace.h"
+#include "clock.h"
+#include "fake_event_source.h"
+#include "log_ring.h"
+#include "lru_cache.h"
+#include "pending_auth.h"
+#include "persistent_token_cache.h"
+#include "pump.h"
+#include "rate_limiter.h"
+#include "recording_backend.h"
+#include "replay_backend.h"
+#include "stats.h"
+#include "token_cache.h"
+#include "trace.h"
+#include "worker.h"
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <map>
+#include <catch2/catch.hpp>
+#include <thread>
+#include <vector>
+
+TEST_CASE("TokenCache NormalizesScopes", "[TokenCache]")
+{
+    TokenCache cache;
+    auto expiresOn = std::chrono::system_clock::now() + std::chrono::hours(1);
+    cache.Put("authority", "B a/.default", CachedToken{"account", "token", expiresOn});
+
+    auto cached = cache.Get("authority", "a/.default b", "account");
+    REQUIRE(cached != nullptr);
+    CHECK(cached->token == "token");
+    CHECK(cache.Get("authority", "a", "account") == nullptr);
+    CHECK(cache.Get("authority", "a b", "other") == nullptr);
+}
+
+TEST_CASE("TokenCache Skew", "[TokenCache]")
+{
+    TokenCache cache;
+    cache.SetExpirySkew(std::chrono::minutes(5));
+    cache.Put("authority", "scope", CachedToken{"account", "token", std::chrono::system_clock::now() + std::chrono::minutes(4)});
+    CHECK(cache.Get("authority", "scope", "account") == nullptr);
+}
+
+TEST_CASE("TokenCache Refresh", "[TokenCache]")
+{
+    TokenCache cache;
+    cache.SetRefreshWindow(std::chrono::minutes(10));
+    cache.Put("authority", "scope", CachedToken{"account", "token", std::chrono::system_clock::now() + std::chrono::minutes(8)});
+
+    auto refresh = false;
+    REQUIRE(cache.Get("authority", "scope", "account", &refresh) != nullptr);
+    CHECK(refresh);
+    // a refresh is in progress, so the cache doesn't ask for another
+    REQUIRE(cache.Get("authority", "scope", "account", &refresh) != nullptr);
+    CHECK_FALSE(refresh);
+}
+
+TEST_CASE("LruCache EvictsLeastRecentlyUsed", "[LruCache]")
+{
+    LruCache<int> cache(2);
+    cache.Put("a", std::make_shared<int>(1));
+    cache.Put("b", std::make_shared<int>(2));
+    cache.Get("a");
+    cache.Put("c", std::make_shared<int>(3));
+
+    CHECK(cache.Get("a") != nullptr);
+    CHECK(cache.Get("b") == nullptr);
+    CHECK(cache.Get("c") != nullptr);
+    CHECK(cache.Hits() == 3u);
+    CHECK(cache.Misses() == 1u);
+}
+
+TEST_CASE("PendingAuth CompletesOnce", "[PendingAuth]")
+{
+    PendingAuth pending;
+    auto calls = 0;
+    pending.Subscribe([&calls]
+                      { calls++; });
+    TokenResult first;
+    first.token = "first";
+    pending.Complete(first);
+    TokenResult second;
+    second.token = "second";
+    pending.Complete(second);
+
+    CHECK(calls == 1);
+    auto result = pending.Wait(std::chrono::milliseconds(0));
+    REQUIRE(result);
+    CHECK(result->token == "first");
+}
+
+TEST_CASE("InflightRequests Join", "[InflightRequests]")
+{
+    InflightRequests inflight(std::chrono::minutes(1));
+    auto [first, started] = inflight.Join("key");
+    CHECK(started);
+    auto [second, startedAgain] = inflight.Join("key");
+    CHECK_FALSE(startedAgain);
+    CHECK(first == second);
+
+    first->Complete(TokenResult());
+    CHECK(inflight.Find("key") == nullptr);
+}
+
+TEST_CASE("Worker Run", "[Worker]")
+{
+    Worker worker;
+    std::vector<int> order;
+    worker.Post([&order]
+                { order.push_back(1); });
+    auto caller = std::this_thread::get_id();
+    std::thread::id runner;
+    CHECK(worker.Run([&]
+                     {
+                         order.push_back(2);
+                         runner = std::this_thread::get_id();
+                     }));
+    // Run waited for the task, which ran on the worker's thread after the posted task
+    CHECK(order == std::vector<int>{1, 2});
+    CHECK(runner != caller);
+    worker.Stop();
+    CHECK_FALSE(worker.Run([&order]
+                           { order.push_back(3); }));
+    CHECK(order.size() == 2);
+}
+
+TEST_CASE("Worker RunRacesStop", "[Worker]")
+{
+    Worker worker;
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    worker.Post([released]
+                { released.wait(); });
+    std::atomic<bool> ran{false};
+    // the worker is busy, so this task waits in the queue until Stop discards it
+    auto run = std::async(std::launch::async, [&]
+                          { return worker.Run([&ran]
+                                              { ran = true; }); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto stop = std::async(std::launch::async, [&worker]
+                           { worker.Stop(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    release.set_value();
+    REQUIRE(run.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    CHECK_FALSE(run.get());
+    CHECK_FALSE(ran.load());
+    stop.wait();
+}
+
+TEST_CASE("LogRing DropsWhenFull", "[LogRing]")
+{
+    LogRing ring(2);
+    CHECK(ring.Push("a", 1));
+    CHECK(ring.Push("b", 1));
+    CHECK_FALSE(ring.Push("c", 1));
+    CHECK(ring.Dropped() == 1u);
+
+    LogRecord record;
+    REQUIRE(ring.Pop(&record));
+    CHECK(std::string(record.message) == "a");
+    REQUIRE(ring.Pop(&record));
+    CHECK(std::string(record.message) == "b");
+    CHECK_FALSE(ring.Pop(&record));
+}
+
+TEST_CASE("RateLimiter Allow", "[RateLimiter]")
+{
+    RateLimiter limiter;
+    auto now = std::chrono::steady_clock::now();
+    CHECK(limiter.Allow(now));
+
+    limiter.SetLimit(2);
+    auto second = std::chrono::steady_clock::time_point(std::chrono::seconds(100));
+    CHECK(limiter.Allow(second));
+    CHECK(limiter.Allow(second));
+    CHECK_FALSE(limiter.Allow(second));
+    CHECK(limiter.Allow(second + std::chrono::seconds(1)));
+}
+
+TEST_CASE("Histogram Buckets", "[Histogram]")
+{
+    Histogram histogram;
+    histogram.Record(std::chrono::microseconds(500));
+    histogram.Record(std::chrono::milliseconds(3));
+    histogram.Record(std::chrono::hours(1));
+
+    LatencyHistogram h{};
+    histogram.Read(&h);
+    CHECK(h.count == 3u);
+    CHECK(h.buckets[0] == 1u);
+    CHECK(h.buckets[2] == 1u);
+    CHECK(h.buckets[19] == 1u);
+}
+
+TEST_CASE("Pump DispatchesUntilDone", "[Pump]")
+{
+    FakeEventSource source;
+    std::atomic<bool> done{false};
+    std::thread poster(
+        [&source, &done]
+        {
+            source.Post();
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            done = true;
+            source.Signal();
+        });
+    auto finished = Pump(source, std::chrono::steady_clock::now() + std::chrono::seconds(5), [&done]
+                         { return done.load(); });
+    poster.join();
+    CHECK(finished == PumpResult::Done);
+    CHECK(source.Dispatched() == 1);
+}
+
+TEST_CASE("Pump Deadline", "[Pump]")
+{
+    FakeEventSource source;
+    auto finished = Pump(source, std::chrono::steady_clock::now() + std::chrono::milliseconds(20), []
+                         { return false; });
+    CHECK(finished == PumpResult::DeadlinePassed);
+}
+
+TEST_CASE("Pump StopsOnFailure", "[Pump]")
+{
+    FakeEventSource source;
+    source.Fail();
+    auto start = std::chrono::steady_clock::now();
+    auto finished = Pump(source, start + std::chrono::seconds(5), []
+                         { return false; });
+    CHECK(finished == PumpResult::Failed);
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+}
+
+// tokenFile is a temporary token cache file
+struct tokenFile
+{
+    std::string path = (std::filesystem::temp_directory_path() / "components_test.tokens").string();
+
+    tokenFile()
+    {
+        std::filesystem::remove(path);
+    }
+
+    ~tokenFile()
+    {
+        std::filesystem::remove(path);
+    }
+};
+
+#if !defined(_WIN32)
+TEST_CASE_METHOD(tokenFile, "PersistentTokenCache RestrictsPermissions", "[PersistentTokenCache]")
+{
+    {
+        std::ofstream create(path);
+    }
+    namespace fs = std::filesystem;
+    fs::permissions(path, fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read | fs::perms::others_read);
+    PersistentTokenCache cache;
+    REQUIRE(cache.Open(path, "client") == "");
+    CHECK(fs::status(path).permissions() == (fs::perms::owner_read | fs::perms::owner_write));
+}
+#endif
+
+TEST_CASE_METHOD(tokenFile, "PersistentTokenCache SharesTokens", "[PersistentTokenCache]")
+{
+    PersistentTokenCache writer, reader, otherClient;
+    REQUIRE(writer.Open(path, "client") == "");
+    REQUIRE(reader.Open(path, "client") == "");
+    REQUIRE(otherClient.Open(path, "other client") == "");
+    auto expiresOn = std::chrono::time_point_cast<std::chrono::seconds>(std::chrono::system_clock::now() + std::chrono::hours(1));
+    writer.Put("https://authority/", "b a/.default", CachedToken{"account", "token", expiresOn});
+
+    auto cached = reader.Get("https://AUTHORITY", "a b", "account");
+    REQUIRE(cached != nullptr);
+    CHECK(cached->accountID == "account");
+    CHECK(cached->token == "token");
+    CHECK(cached->expiresOn == expiresOn);
+    CHECK(reader.Get("https://authority", "a b", "other account") == nullptr);
+    CHECK(otherClient.Get("https://authority", "a b", "account") == nullptr);
+
+    // the default skew is 5 minutes
+    writer.Put("https://authority", "c", CachedToken{"account", "token", std::chrono::system_clock::now() + std::chrono::minutes(4)});
+    CHECK(reader.Get("https://authority", "c", "account") == nullptr);
+
+    reader.Clear();
+    CHECK(writer.Get("https://authority", "a b", "account") == nullptr);
+}
+
+TEST_CASE_METHOD(tokenFile, "PersistentTokenCache ReplacesSoonestExpiring", "[PersistentTokenCache]")
+{
+    PersistentTokenCache cache;
+    REQUIRE(cache.Open(path, "client") == "");
+    auto now = std::chrono::system_clock::now();
+    // the file has 32 slots
+    for (int i = 0; i < 32; i++)
+    {
+        cache.Put("authority", "scope" + std::to_string(i), CachedToken{"account", "token", now + std::chrono::hours(1) + std::chrono::minutes(i)});
+    }
+    cache.Put("authority", "new scope", CachedToken{"account", "token", now + std::chrono::hours(2)});
+    CHECK(cache.Get("authority", "scope0", "account") == nullptr);
+    CHECK(cache.Get("authority", "scope1", "account") != nullptr);
+    CHECK(cache.Get("authority", "new scope", "account") != nullptr);
+
+    // tokens too large for a slot aren't cached
+    cache.Put("authority", "large", CachedToken{"account", std::string(32 * 1024, 'x'), now + std::chrono::hours(1)});
+    CHECK(cache.Get("authority", "large", "account") == nullptr);
+    cache.Close();
+    CHECK(cache.Get("authority", "new scope", "account") == nullptr);
+}
+
+// manualClock sets a ManualClock for the duration of a test
+struct manualClock
+{
+    ManualClock clock;
+
+    manualClock()
+    {
+        SetClock(&clock);
+    }
+
+    ~manualClock()
+    {
+        SetClock(nullptr);
+    }
+};
+
+TEST_CASE_METHOD(manualClock, "ManualClock TokenExpiry", "[ManualClock]")
+{
+    TokenCache cache;
+    cache.SetRefreshWindow(std::chrono::minutes(15));
+    cache.Put("authority", "scope", CachedToken{"account", "token", clock.SystemNow() + std::chrono::hours(1)});
+
+    auto refresh = false;
+    clock.Advance(std::chrono::minutes(44));
+    REQUIRE(cache.Get("authority", "scope", "account", &refresh) != nullptr);
+    CHECK_FALSE(refresh);
+
+    clock.Advance(std::chrono::minutes(2));
+    REQUIRE(cache.Get("authority", "scope", "account", &refresh) != nullptr);
+    CHECK(refresh);
+
+    // the default skew is 5 minutes
+    clock.Advance(std::chrono::minutes(10));
+    CHECK(cache.Get("authority", "scope", "account") == nullptr);
+}
+
+TEST_CASE_METHOD(manualClock, "ManualClock PendingAuthTimeout", "[ManualClock]")
+{
+    PendingAuth pending;
+    auto result = std::async(std::launch::async, [&pending]
+                             { return pending.Wait(std::chrono::seconds(60)); });
+    // advance until the wait ends, since it may not have started yet
+    auto start = std::chrono::steady_clock::now();
+    while (result.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready)
+    {
+        clock.Advance(std::chrono::seconds(10));
+    }
+    CHECK_FALSE(result.get());
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+}
+
+TEST_CASE_METHOD(manualClock, "ManualClock InflightMaxAge", "[ManualClock]")
+{
+    InflightRequests inflight(std::chrono::seconds(60));
+    auto [first, started] = inflight.Join("key");
+    REQUIRE(started);
+    clock.Advance(std::chrono::seconds(59));
+    CHECK(inflight.Find("key") == first);
+    clock.Advance(std::chrono::seconds(1));
+    CHECK(inflight.Find("key") == nullptr);
+}
+
+TEST_CASE_METHOD(manualClock, "ManualClock PumpDeadline", "[ManualClock]")
+{
+    FakeEventSource source;
+    auto deadline = clock.Now() + std::chrono::hours(1);
+    auto finished = std::async(std::launch::async, [&source, deadline]
+                               { return Pump(source, deadline, []
+                                             { return false; }); });
+    while (finished.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready)
+    {
+        clock.Advance(std::chrono::minutes(10));
+    }
+    CHECK(finished.get() == PumpResult::DeadlinePassed);
+}
+
+// scriptedBackend answers AcquireTokenSilently on the calling thread, SignInInteractively on another thread and
+// never answers SignInSilently
+class scriptedBackend : public Backend
+{
+public:
+    std::string Startup(const std::string &, const std::string &, const std::string &) override { return ""; }
+    void Shutdown() override
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+    void SetLogging(int, BackendLogCallback) override {}
+    std::string NewCorrelationID() override { return "id"; }
+    std::shared_ptr<BackendAccount> ReadAccount(const std::string &accountID, const std::string &) override
+    {
+        if (accountID != "account")
+        {
+            return nullptr;
+        }
+        auto account = std::make_shared<BackendAccount>();
+        account->id = accountID;
+        return account;
+    }
+    void AcquireTokenSilently(const BackendAccount &account, const std::string &, const std::string &, const std::string &, Callback callback) override
+    {
+        TokenResult result;
+        result.accountID = account.id;
+        result.token = "token";
+        result.expiresOn = std::chrono::time_point_cast<std::chrono::system_clock::duration>(std::chrono::system_clock::now() + std::chrono::hours(1));
+        callback(std::move(result));
+    }
+    void SignInInteractively(const std::string &, const std::string &, const std::string &, Callback callback) override
+    {
+        thread = std::thread([callback]
+                             {
+                                 TokenResult result;
+                                 result.error = "canceled";
+                                 callback(std::move(result)); });
+    }
+    void SignInSilently(const std::string &, Callback) override {}
+    void SignOut() override {}
+    std::shared_ptr<EventSource> NewEventSource() override { return std::make_shared<FakeEventSource>(); }
+
+private:
+    std::thread thread;
+};
+
+TEST_CASE("BackendTrace RecordAndReplay", "[BackendTrace]")
+{
+    auto path = (std::filesystem::temp_directory_path() / "components_test.trace").string();
+    std::vector<TokenResult> results;
+    auto collect = [&results](TokenResult r)
+    { results.push_back(std::move(r)); };
+
+    auto recorder = NewRecordingBackend(std::make_unique<scriptedBackend>(), path);
+    REQUIRE(recorder->Startup("client", "app", "1.0") == "");
+    CHECK(recorder->ReadAccount("other", "id") == nullptr);
+    auto account = recorder->ReadAccount("account", "id");
+    REQUIRE(account != nullptr);
+    recorder->AcquireTokenSilently(*account, "authority", "scope", "id", collect);
+    recorder->SignInInteractively("authority", "scope", "id", collect);
+    recorder->SignInSilently("id", collect);
+    recorder->Shutdown();
+    REQUIRE(results.size() == 2);
+
+    std::vector<BackendTraceRecord> trace;
+    REQUIRE(ReadBackendTrace(path, &trace));
+    REQUIRE(trace.size() == 6);
+    CHECK(std::filesystem::file_size(path) == 8 + trace.size() * backendTraceRecordSize);
+    std::map<BackendOperation, std::vector<BackendTraceRecord>> byOperation;
+    for (auto &r : trace)
+    {
+        byOperation[r.operation].push_back(r);
+    }
+    CHECK(byOperation[BackendOperation::Startup][0].argumentsHash == hashArguments({"client", "app", "1.0"}));
+    REQUIRE(byOperation[BackendOperation::ReadAccount].size() == 2);
+    auto acquire = byOperation[BackendOperation::AcquireTokenSilently].at(0);
+    CHECK(acquire.result == BackendResultClass::Success);
+    CHECK(acquire.callbackThread == 0);
+    CHECK(acquire.lifetimeSeconds > 3500);
+    auto interactive = byOperation[BackendOperation::SignInInteractively].at(0);
+    CHECK(interactive.result == BackendResultClass::Error);
+    CHECK(interactive.callbackThread != 0);
+    CHECK(byOperation[BackendOperation::SignInSilently].at(0).result == BackendResultClass::Dropped);
+
+    results.clear();
+    auto replay = NewReplayBackend(path);
+    REQUIRE(replay->Startup("client", "app", "1.0") == "");
+    // the hash matches the second ReadAccount record, though the first was recorded first
+    account = replay->ReadAccount("account", "id");
+    REQUIRE(account != nullptr);
+    CHECK(replay->ReadAccount("account", "id") == nullptr);
+    replay->AcquireTokenSilently(*account, "authority", "scope", "id", collect);
+    REQUIRE(results.size() == 1);
+    CHECK(results[0].error.empty());
+    CHECK(results[0].expiresOn - std::chrono::system_clock::now() > std::chrono::seconds(3500));
+    std::promise<TokenResult> interactiveResult;
+    replay->SignInInteractively("authority", "scope", "id", [&interactiveResult](TokenResult r)
+                                { interactiveResult.set_value(std::move(r)); });
+    CHECK(interactiveResult.get_future().get().error == "replayed SignInInteractively failure");
+    replay->SignInSilently("id", collect);
+    // the trace has no more AcquireTokenSilently calls
+    replay->AcquireTokenSilently(*account, "authority", "scope", "id", collect);
+    REQUIRE(results.size() == 2);
+    CHECK_FALSE(results[1].error.empty());
+    replay->Shutdown();
+
+    CHECK(NewReplayBackend(path + ".missing")->Startup("client", "app", "1.0") != "");
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Tracer MaxEvents", "[Tracer]")
+{
+    auto path = (std::filesystem::temp_directory_path() / "components_test.json").string();
+#if defined(_WIN32)
+    _putenv_s("AZD_ONEAUTH_TRACE_FILE", path.c_str());
+#else
+    setenv("AZD_ONEAUTH_TRACE_FILE", path.c_str(), 1);
+#endif
+    {
+        Tracer t;
+        t.Enable();
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < Tracer::maxEvents + 3; i++)
+        {
+            t.Record("event", now, now);
+        }
+        t.Flush();
+    }
+#if defined(_WIN32)
+    _putenv_s("AZD_ONEAUTH_TRACE_FILE", "");
+#else
+    unsetenv("AZD_ONEAUTH_TRACE_FILE");
+#endif
+
+    std::ifstream f(path);
+    std::string trace((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    f.close();
+    size_t events = 0;
+    for (auto i = trace.find("\"name\""); i != std::string::npos; i = trace.find("\"name\"", i + 1))
+    {
+        events++;
+    }
+    CHECK(events == Tracer::maxEvents);
+    CHECK(trace.find("\"droppedEvents\":\"3\"") != std::string::npos);
+    std::filesystem::remove(path);
+}
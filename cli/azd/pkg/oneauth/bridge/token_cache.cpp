@@ -0,0 +1,153 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "token_cache.h"
+#include "clock.h"
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+    // refreshRetryInterval is how long the cache waits before asking for another refresh of a token, in
+    // case the previous refresh failed
+    const auto refreshRetryInterval = std::chrono::seconds(30);
+
+    std::string lower(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        return s;
+    }
+}
+
+std::string tokenKey(const std::string &authority, const std::string &scope, const std::string &accountID)
+{
+    auto a = lower(authority);
+    while (!a.empty() && a.back() == '/')
+    {
+        a.pop_back();
+    }
+    // '\n' can't appear in any of the components, so the key is unambiguous
+    return a + '\n' + normalizeScope(scope) + '\n' + accountID;
+}
+
+std::string normalizeScope(const std::string &scope)
+{
+    const std::string defaultSuffix = "/.default";
+    std::vector<std::string> scopes;
+    std::istringstream in(scope);
+    std::string s;
+    while (in >> s)
+    {
+        s = lower(s);
+        // OneAuth appends "/.default" to scopes, so "x" and "x/.default" are equivalent
+        if (s.size() > defaultSuffix.size() && s.compare(s.size() - defaultSuffix.size(), defaultSuffix.size(), defaultSuffix) == 0)
+        {
+            s.erase(s.size() - defaultSuffix.size());
+        }
+        scopes.push_back(s);
+    }
+    std::sort(scopes.begin(), scopes.end());
+    scopes.erase(std::unique(scopes.begin(), scopes.end()), scopes.end());
+
+    std::string normalized;
+    for (const auto &s : scopes)
+    {
+        if (!normalized.empty())
+        {
+            normalized += ' ';
+        }
+        normalized += s;
+    }
+    return normalized;
+}
+
+bool TokenCache::usable(const CachedToken &token, std::chrono::system_clock::time_point now) const
+{
+    return expirySkew.count() >= 0 && now + expirySkew < token.expiresOn;
+}
+
+std::shared_ptr<const CachedToken> TokenCache::Get(const std::string &authority, const std::string &scope, const std::string &accountID, bool *refresh)
+{
+    if (refresh)
+    {
+        *refresh = false;
+    }
+    if (accountID.empty())
+    {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mu);
+    auto it = tokens.find(tokenKey(authority, scope, accountID));
+    if (it == tokens.end())
+    {
+        return nullptr;
+    }
+    auto now = GetClock().SystemNow();
+    if (!usable(*it->second.token, now))
+    {
+        tokens.erase(it);
+        return nullptr;
+    }
+    if (refresh && refreshWindow > expirySkew && now + refreshWindow >= it->second.token->expiresOn)
+    {
+        auto steadyNow = GetClock().Now();
+        if (it->second.refreshStarted == std::chrono::steady_clock::time_point() || steadyNow - it->second.refreshStarted >= refreshRetryInterval)
+        {
+            it->second.refreshStarted = steadyNow;
+            *refresh = true;
+        }
+    }
+    return it->second.token;
+}
+
+void TokenCache::Put(const std::string &authority, const std::string &scope, const CachedToken &token)
+{
+    if (token.accountID.empty() || token.token.empty())
+    {
+        return;
+    }
+    auto now = GetClock().SystemNow();
+    std::lock_guard<std::mutex> lock(mu);
+    if (!usable(token, now))
+    {
+        return;
+    }
+    // drop expired tokens so the cache can't grow without bound over a long-running command
+    for (auto it = tokens.begin(); it != tokens.end();)
+    {
+        it = usable(*it->second.token, now) ? std::next(it) : tokens.erase(it);
+    }
+    auto &e = tokens[tokenKey(authority, scope, token.accountID)];
+    // OneAuth may answer a refresh with the token it already returned, in which case the cache should
+    // wait for the retry interval before requesting another refresh
+    if (!e.token || e.token->token != token.token)
+    {
+        e.refreshStarted = {};
+    }
+    e.token = std::make_shared<const CachedToken>(token);
+}
+
+void TokenCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mu);
+    tokens.clear();
+}
+
+void TokenCache::SetExpirySkew(std::chrono::seconds skew)
+{
+    std::lock_guard<std::mutex> lock(mu);
+    expirySkew = skew;
+    if (skew.count() < 0)
+    {
+        tokens.clear();
+    }
+}
+
+void TokenCache::SetRefreshWindow(std::chrono::seconds window)
+{
+    std::lock_guard<std::mutex> lock(mu);
+    refreshWindow = window;
+}
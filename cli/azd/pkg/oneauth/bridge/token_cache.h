@@ -0,0 +1,65 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// CachedToken is an access token the bridge previously acquired from OneAuth.
+struct CachedToken
+{
+    std::string accountID;
+    std::string token;
+    std::chrono::system_clock::time_point expiresOn;
+};
+
+// TokenCache keeps access tokens in memory so Authenticate can return them without a round trip through
+// OneAuth. Tokens are keyed by authority, normalized scope and account ID. The cache doesn't return a token
+// that will expire within the configured skew, so callers always have time to use the token it returns.
+//
+// When a refresh window is set, the cache also tells callers when a token it returns will expire within that
+// window, so they can refresh the token ahead of its expiration while still using the cached value.
+class TokenCache
+{
+public:
+    // Get returns a cached token, if the cache has one that won't expire within the skew. When refresh isn't null,
+    // Get sets it true if the token is within the refresh window and no refresh of it started recently. The caller
+    // is then responsible for refreshing the token and adding the new token to the cache. Returns nullptr when the
+    // cache has no usable token. The returned token is immutable and shared, so a cache hit doesn't copy it.
+    std::shared_ptr<const CachedToken> Get(const std::string &authority, const std::string &scope, const std::string &accountID, bool *refresh = nullptr);
+    // Put caches token for the given authority and scope. Its account ID is part of the key.
+    void Put(const std::string &authority, const std::string &scope, const CachedToken &token);
+    void Clear();
+    // SetExpirySkew sets how long before expiration the cache stops returning a token. A
+    // negative skew disables the cache.
+    void SetExpirySkew(std::chrono::seconds skew);
+    // SetRefreshWindow sets how long before expiration Get starts asking callers to refresh a token.
+    // A window no longer than the expiry skew disables refresh-ahead, which is the default.
+    void SetRefreshWindow(std::chrono::seconds window);
+
+private:
+    struct entry
+    {
+        std::shared_ptr<const CachedToken> token;
+        // refreshStarted is when Get last asked a caller to refresh the token
+        std::chrono::steady_clock::time_point refreshStarted;
+    };
+
+    bool usable(const CachedToken &token, std::chrono::system_clock::time_point now) const;
+
+    std::chrono::seconds expirySkew = std::chrono::minutes(5);
+    std::chrono::seconds refreshWindow = std::chrono::seconds(0);
+    std::mutex mu;
+    std::unordered_map<std::string, entry> tokens;
+};
+
+// tokenKey returns the key identifying tokens for the given authority, scope and account
+std::string tokenKey(const std::string &authority, const std::string &scope, const std::string &accountID);
+
+// normalizeScope returns a canonical form of a space-delimited scope string, so that equivalent
+// scopes e.g. "A b" and "b a/.default" share cache entries
+std::string normalizeScope(const std::string &scope);
@@ -0,0 +1,129 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "trace.h"
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+Tracer tracer;
+
+namespace
+{
+    // threadNumber returns a small number identifying the calling thread, which makes traces easier to read
+    // than the OS's thread IDs
+    uint32_t threadNumber()
+    {
+        static std::atomic<uint32_t> next{1};
+        thread_local uint32_t number = next.fetch_add(1);
+        return number;
+    }
+
+    void writeJSONString(FILE *f, const std::string &s)
+    {
+        fputc('"', f);
+        for (auto c : s)
+        {
+            switch (c)
+            {
+            case '"':
+                fputs("\\\"", f);
+                break;
+            case '\\':
+                fputs("\\\\", f);
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    fprintf(f, "\\u%04x", c);
+                }
+                else
+                {
+                    fputc(c, f);
+                }
+            }
+        }
+        fputc('"', f);
+    }
+}
+
+Tracer::~Tracer()
+{
+    Flush();
+}
+
+void Tracer::Enable()
+{
+    std::lock_guard<std::mutex> lock(mu);
+    if (Enabled())
+    {
+        return;
+    }
+    auto p = std::getenv("AZD_ONEAUTH_TRACE_FILE");
+    if (p && *p)
+    {
+        path = p;
+        origin = std::chrono::steady_clock::now();
+        enabled.store(true);
+    }
+}
+
+void Tracer::Record(const char *name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, const std::string &detail)
+{
+    if (!Enabled())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mu);
+    if (events.size() >= maxEvents)
+    {
+        dropped++;
+        return;
+    }
+    events.push_back(Event{
+        name,
+        std::chrono::duration_cast<std::chrono::microseconds>(start - origin).count(),
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(),
+        threadNumber(),
+        detail});
+}
+
+void Tracer::Flush()
+{
+    if (!Enabled())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mu);
+    auto f = fopen(path.c_str(), "w");
+    if (!f)
+    {
+        return;
+    }
+    // complete ("X") events have a start and a duration, so each is one record rather than a begin/end pair
+    fputs("{\"traceEvents\":[", f);
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        auto &e = events[i];
+        fprintf(f, "%s\n{\"name\":", i ? "," : "");
+        writeJSONString(f, e.name);
+        fprintf(f, ",\"cat\":\"bridge\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%u", static_cast<long long>(e.start), static_cast<long long>(e.duration), e.thread);
+        if (!e.detail.empty())
+        {
+            fputs(",\"args\":{\"detail\":", f);
+            writeJSONString(f, e.detail);
+            fputc('}', f);
+        }
+        fputc('}', f);
+    }
+    fprintf(f, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":\"%llu\"}}\n", static_cast<unsigned long long>(dropped));
+    fclose(f);
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (tracer.Enabled())
+    {
+        tracer.Record(name, start, std::chrono::steady_clock::now());
+    }
+}
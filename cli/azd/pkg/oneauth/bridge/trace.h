@@ -0,0 +1,68 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Tracer records the bridge's operations as Chrome trace events (viewable in chrome://tracing or Perfetto)
+// when the environment variable AZD_ONEAUTH_TRACE_FILE names a file. It buffers events in memory and writes
+// them to that file on Flush. When tracing is disabled, recording an event costs one atomic load.
+class Tracer
+{
+public:
+    // maxEvents bounds the events the tracer buffers. It drops events beyond that and reports the number it
+    // dropped in the trace's metadata.
+    static constexpr size_t maxEvents = 100000;
+
+    ~Tracer();
+
+    // Enable enables tracing when AZD_ONEAUTH_TRACE_FILE is set. It does nothing when tracing is enabled.
+    void Enable();
+    bool Enabled() const { return enabled.load(std::memory_order_relaxed); }
+    // Record records an operation that ran from start to end. The event appears on the calling thread's track
+    // in the trace. detail, when not empty, appears in the event's arguments.
+    void Record(const char *name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end, const std::string &detail = "");
+    // Flush writes all events recorded so far to the trace file, replacing its content
+    void Flush();
+
+private:
+    struct Event
+    {
+        const char *name;
+        int64_t start;
+        int64_t duration;
+        uint32_t thread;
+        std::string detail;
+    };
+
+    std::atomic<bool> enabled{false};
+    std::mutex mu;
+    std::string path;
+    std::vector<Event> events;
+    uint64_t dropped = 0;
+    std::chrono::steady_clock::time_point origin;
+};
+
+// tracer is the bridge's Tracer
+extern Tracer tracer;
+
+// TraceSpan records the lifetime of a scope with the bridge's Tracer
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name) : name(name), start(std::chrono::steady_clock::now()) {}
+    ~TraceSpan();
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *name;
+    std::chrono::steady_clock::time_point start;
+};
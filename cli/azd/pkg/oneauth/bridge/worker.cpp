@@ -0,0 +1,96 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "worker.h"
+#include <atomic>
+#include <future>
+#include <memory>
+
+Worker::~Worker()
+{
+    Stop();
+}
+
+void Worker::Post(std::function<void()> task)
+{
+    enqueue(std::move(task));
+}
+
+bool Worker::Run(std::function<void()> task)
+{
+    // the queued task owns the only reference to the promise, so the future becomes ready when the task
+    // finishes or Stop destroys it
+    auto done = std::make_shared<std::promise<void>>();
+    auto finished = done->get_future();
+    auto ran = std::make_shared<std::atomic<bool>>(false);
+    if (!enqueue([task = std::move(task), done = std::move(done), ran]()
+                 {
+                     task();
+                     ran->store(true);
+                     done->set_value();
+                 }))
+    {
+        return false;
+    }
+    finished.wait();
+    return ran->load();
+}
+
+bool Worker::enqueue(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        if (stopped)
+        {
+            return false;
+        }
+        tasks.push_back(std::move(task));
+        if (!thread.joinable())
+        {
+            thread = std::thread(&Worker::run, this);
+        }
+    }
+    cv.notify_one();
+    return true;
+}
+
+void Worker::Start()
+{
+    std::lock_guard<std::mutex> lock(mu);
+    stopped = false;
+}
+
+void Worker::Stop()
+{
+    std::thread t;
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        stopped = true;
+        tasks.clear();
+        t = std::move(thread);
+    }
+    cv.notify_all();
+    if (t.joinable())
+    {
+        t.join();
+    }
+}
+
+void Worker::run()
+{
+    std::unique_lock<std::mutex> lock(mu);
+    while (true)
+    {
+        cv.wait(lock, [this]
+                { return stopped || !tasks.empty(); });
+        if (stopped)
+        {
+            return;
+        }
+        auto task = std::move(tasks.front());
+        tasks.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
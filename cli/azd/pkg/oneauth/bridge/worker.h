@@ -0,0 +1,38 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Worker runs tasks in order on a thread owned by the bridge, so that work such as refreshing tokens
+// doesn't happen on a caller's thread. The thread starts with the first task.
+class Worker
+{
+public:
+    ~Worker();
+
+    // Post queues a task. It has no effect after Stop.
+    void Post(std::function<void()> task);
+    // Run queues a task and waits for it to return, or for Stop to discard it. It returns true when the task ran,
+    // and false when Stop discarded it or had already been called. Tasks mustn't call Run.
+    bool Run(std::function<void()> task);
+    // Start allows Post to queue tasks again after Stop
+    void Start();
+    // Stop discards queued tasks and waits for the running task, if any, to return
+    void Stop();
+
+private:
+    bool enqueue(std::function<void()> task);
+    void run();
+
+    std::condition_variable cv;
+    std::mutex mu;
+    bool stopped = false;
+    std::deque<std::function<void()>> tasks;
+    std::thread thread;
+};
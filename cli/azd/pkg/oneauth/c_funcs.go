@@ -6,11 +6,13 @@
 package oneauth
 
 /*
-extern void goLog(char *s);
+#include <stdint.h>
 
-// enables native code to call goLog (can't pass a Go function pointer to C)
-void goLogGateway(char *s) {
-	goLog(s);
+extern void goAuthComplete(uintptr_t context);
+
+// enables native code to call goAuthComplete
+void goAuthCompleteGateway(uintptr_t context) {
+	goAuthComplete(context);
 }
 */
 import "C"
@@ -0,0 +1,213 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+//go:build oneauth && windows
+
+package oneauth
+
+import (
+	"context"
+	"fmt"
+	"os"
+	"runtime"
+	"sort"
+	"sync"
+	"testing"
+	"time"
+	"unsafe"
+
+	"github.com/Azure/azure-sdk-for-go/sdk/azcore/policy"
+	"github.com/stretchr/testify/require"
+)
+
+// fakeBridgeEnvVar names a bridge DLL built with the fake backend, which the load benchmarks require:
+//
+//	cmake -S bridge -B bridge/_fake -DBRIDGE_FAKE_BACKEND=ON && cmake --build bridge/_fake --config Release
+//	set AZD_ONEAUTH_FAKE_BRIDGE=%CD%\bridge\_fake\Release\bridge.dll
+//	go test -tags oneauth -run none -bench Load ./pkg/oneauth
+const fakeBridgeEnvVar = "AZD_ONEAUTH_FAKE_BRIDGE"
+
+const (
+	loadAuthority = "https://login.microsoftonline.com/organizations"
+	loadClientID  = "7922c055-2cb8-4450-9669-c4952562f2b9"
+)
+
+// fakeOperation mirrors FakeOperation in bridge/backends/fake/fake_backend.h
+type fakeOperation struct {
+	latencyMilliseconds int32
+	fail, dropCallback  bool
+	_                   [2]byte
+}
+
+// fakeBackendOptions mirrors FakeBackendOptions in bridge/backends/fake/fake_backend.h
+type fakeBackendOptions struct {
+	startup, readAccount, acquireSilently, signInInteractively, signInSilently fakeOperation
+	tokenLifetimeSeconds, tokenLength                                          int32
+}
+
+// scopeMix approximates the token requests of a large provision, which are mostly for ARM with some for data
+// planes. Each scope appears in proportion to how often azd requests it.
+var scopeMix = func() [][]string {
+	mix := [][]string{}
+	for _, s := range []struct {
+		scope  string
+		weight int
+	}{
+		{"https://management.azure.com//.default", 12},
+		{"https://vault.azure.net/.default", 3},
+		{"https://storage.azure.com/.default", 2},
+		{"https://graph.microsoft.com/.default", 1},
+		{"https://cognitiveservices.azure.com/.default", 1},
+		{"https://ossrdbms-aad.database.windows.net/.default", 1},
+	} {
+		for i := 0; i < s.weight; i++ {
+			mix = append(mix, []string{s.scope})
+		}
+	}
+	return mix
+}()
+
+// loadFakeBridge loads the fake-backend bridge, skipping b when there isn't one
+func loadFakeBridge(b *testing.B) {
+	p := os.Getenv(fakeBridgeEnvVar)
+	if p == "" {
+		b.Skipf("set %s to the path of a bridge DLL built with the fake backend", fakeBridgeEnvVar)
+	}
+	if bridge == nil {
+		require.NoError(b, loadBridge(p))
+		// keep fake tokens out of the user's token cache file
+		tokenCacheMu.Lock()
+		tokenCacheTried = true
+		tokenCacheMu.Unlock()
+	} else if bridge.Name != p {
+		b.Skip("this process already loaded the production bridge")
+	}
+}
+
+// configureFake sets the fake backend's options and the bridge's token cache skew. A negative skew disables
+// the cache, so every request reaches the backend.
+func configureFake(b *testing.B, opts fakeBackendOptions, expirySkewSeconds int) {
+	configure, err := bridge.FindProc("ConfigureFakeBackend")
+	require.NoError(b, err)
+	configure.Call(uintptr(unsafe.Pointer(&opts)))
+	configureCache, err := bridge.FindProc("ConfigureTokenCache")
+	require.NoError(b, err)
+	configureCache.Call(uintptr(expirySkewSeconds))
+}
+
+type loadResult struct {
+	tokens   int
+	elapsed  time.Duration
+	p50, p99 time.Duration
+	// cgoCalls counts calls from Go to native code, including calls to the bridge through windows.Proc
+	cgoCalls int64
+	mallocs  uint64
+}
+
+// runLoad acquires tokens from the given number of goroutines, each with its own credential as azd's
+// provisioning does, and measures the result
+func runLoad(b *testing.B, goroutines, tokens int, noPrompt bool) loadResult {
+	// start the bridge before measuring
+	require.NoError(b, start(loadClientID))
+
+	latencies := make([][]time.Duration, goroutines)
+	for i := range latencies {
+		n := tokens / goroutines
+		if i < tokens%goroutines {
+			n++
+		}
+		latencies[i] = make([]time.Duration, n)
+	}
+	errs := make(chan error, goroutines)
+	wg := sync.WaitGroup{}
+	before := runtime.MemStats{}
+	runtime.ReadMemStats(&before)
+	cgoCalls := runtime.NumCgoCall()
+	b.ResetTimer()
+	began := time.Now()
+	for i := 0; i < goroutines; i++ {
+		wg.Add(1)
+		go func(i int) {
+			defer wg.Done()
+			cred, err := NewCredential(loadAuthority, loadClientID, CredentialOptions{HomeAccountID: "fake-account", NoPrompt: noPrompt})
+			if err != nil {
+				errs <- err
+				return
+			}
+			for j := range latencies[i] {
+				opts := policy.TokenRequestOptions{Scopes: scopeMix[(i+j)%len(scopeMix)]}
+				s := time.Now()
+				if _, err := cred.GetToken(context.Background(), opts); err != nil {
+					errs <- err
+					return
+				}
+				latencies[i][j] = time.Since(s)
+			}
+		}(i)
+	}
+	wg.Wait()
+	elapsed := time.Since(began)
+	b.StopTimer()
+	cgoCalls = runtime.NumCgoCall() - cgoCalls
+	after := runtime.MemStats{}
+	runtime.ReadMemStats(&after)
+	close(errs)
+	for err := range errs {
+		require.NoError(b, err)
+	}
+
+	all := make([]time.Duration, 0, tokens)
+	for _, l := range latencies {
+		all = append(all, l...)
+	}
+	sort.Slice(all, func(i, j int) bool { return all[i] < all[j] })
+	percentile := func(p float64) time.Duration {
+		if len(all) == 0 {
+			return 0
+		}
+		return all[int(p*float64(len(all)-1))]
+	}
+	return loadResult{
+		tokens:   len(all),
+		elapsed:  elapsed,
+		p50:      percentile(0.5),
+		p99:      percentile(0.99),
+		cgoCalls: cgoCalls,
+		mallocs:  after.Mallocs - before.Mallocs,
+	}
+}
+
+// BenchmarkGetTokenLoad measures GetToken under the fan-out of a large provision, against the fake backend.
+// "cached" requests are mostly answered from the bridge's token cache, as in practice; "uncached" requests
+// all reach the backend, which takes a few milliseconds to answer each.
+func BenchmarkGetTokenLoad(b *testing.B) {
+	loadFakeBridge(b)
+	for _, bc := range []struct {
+		name     string
+		opts     fakeBackendOptions
+		skew     int
+		noPrompt bool
+	}{
+		{name: "cached/silent", skew: 300, noPrompt: true},
+		{name: "cached/sync", skew: 300},
+		{name: "uncached/silent", opts: fakeBackendOptions{acquireSilently: fakeOperation{latencyMilliseconds: 5}}, skew: -1, noPrompt: true},
+		{name: "uncached/sync", opts: fakeBackendOptions{acquireSilently: fakeOperation{latencyMilliseconds: 5}}, skew: -1},
+	} {
+		for _, goroutines := range []int{1, 64, 256, 512} {
+			b.Run(fmt.Sprintf("%s/goroutines=%d", bc.name, goroutines), func(b *testing.B) {
+				configureFake(b, bc.opts, bc.skew)
+				defer configureFake(b, fakeBackendOptions{}, 300)
+				r := runLoad(b, goroutines, b.N, bc.noPrompt)
+				if r.tokens == 0 {
+					return
+				}
+				b.ReportMetric(float64(r.tokens)/r.elapsed.Seconds(), "tokens/s")
+				b.ReportMetric(float64(r.p50.Microseconds()), "p50-us")
+				b.ReportMetric(float64(r.p99.Microseconds()), "p99-us")
+				b.ReportMetric(float64(r.cgoCalls)/float64(r.tokens), "cgo-calls/token")
+				b.ReportMetric(float64(r.mallocs)/float64(r.tokens), "allocs/token")
+			})
+		}
+	}
+	Shutdown()
+}
@@ -32,4 +32,14 @@ func NewCredential(authority, clientID string, opts CredentialOptions) (azcore.T
 	return nil, errNotSupported
 }
 
+func Preload() {}
+
+func StartAsync(clientID string) {}
+
+func Warmup(authority, clientID, homeAccountID string) {}
+
 func Shutdown() {}
+
+func GetBridgeStats() (BridgeStats, bool) {
+	return BridgeStats{}, false
+}
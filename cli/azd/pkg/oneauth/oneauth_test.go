@@ -30,3 +30,8 @@ func TestNewCredential(t *testing.T) {
 func TestSupported(t *testing.T) {
 	require.False(t, Supported)
 }
+
+func TestGetBridgeStats(t *testing.T) {
+	_, ok := GetBridgeStats()
+	require.False(t, ok)
+}
@@ -7,17 +7,22 @@ package oneauth
 
 /*
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
-// forward declaration; definition in c_funcs.go
-void goLogGateway(char *s);
+// forward declarations; definitions in c_funcs.go
+void goAuthCompleteGateway(uintptr_t context);
 
 // Below definitions must match the ones in bridge.h exactly. We don't include
 // bridge.h because doing so would make the bridge DLL a dependency of azd.exe
 // and prevent distributing the DLL via embedding because Windows won't execute
 // a program's entry point if its DLL dependencies are unavailable.
 
-typedef void (*Logger)(char *);
+typedef struct
+{
+	uint32_t length;
+	char message[1024];
+} LogRecord;
 
 typedef struct
 {
@@ -27,36 +32,166 @@ typedef struct
 	char *token;
 } WrappedAuthResult;
 
+typedef struct
+{
+	int64_t expiresOn;
+	uint32_t accountIDLength;
+	uint32_t tokenLength;
+	uint32_t errorLength;
+	const char *accountID;
+	const char *token;
+	const char *error;
+	const char *correlationID;
+	uint32_t correlationIDLength;
+	uint32_t accountLookupMicroseconds;
+	uint32_t silentWaitMicroseconds;
+	uint32_t pumpMicroseconds;
+	uint32_t marshalMicroseconds;
+} PackedAuthResult;
+
 typedef struct
 {
 	char *message;
 } WrappedError;
+
+typedef struct
+{
+	uint32_t size;
+	uint32_t authorityLength;
+	uint32_t scopeLength;
+	uint32_t accountIDLength;
+	const char *authority;
+	const char *scope;
+	const char *accountID;
+	bool allowPrompt;
+	int64_t deadline;
+	uint64_t cancellationID;
+	bool cacheOnly;
+} AuthenticateRequest;
+
+typedef struct
+{
+	uint64_t hits;
+	uint64_t misses;
+} AccountCacheStats;
+
+typedef struct
+{
+	uint64_t count;
+	uint64_t totalMicroseconds;
+	uint64_t buckets[20];
+} LatencyHistogram;
+
+typedef struct
+{
+	uint32_t size;
+	LatencyHistogram startup;
+	LatencyHistogram readAccount;
+	LatencyHistogram silentAcquisition;
+	LatencyHistogram interactiveSignIn;
+	LatencyHistogram pumpIterations;
+	LatencyHistogram logout;
+	uint64_t timeouts;
+	uint64_t errors;
+} BridgeStats;
+
+// BridgeFunctions declares its members as void * instead of the exports' function pointer types, which have the same size
+typedef struct
+{
+	uint32_t size;
+	void *freeWrappedAuthResult;
+	void *freeWrappedAuthResults;
+	void *freePackedAuthResult;
+	void *freeWrappedError;
+	void *drainLogs;
+	void *startup;
+	void *startupAsync;
+	void *warmup;
+	void *authenticate;
+	void *authenticatePacked;
+	void *authenticateEx;
+	void *cancelAuthenticate;
+	void *authenticateMany;
+	void *openTokenCacheFile;
+	void *configureTokenCache;
+	void *configureTokenRefresh;
+	void *setLogOptions;
+	void *signInSilently;
+	void *authenticateAsync;
+	void *authenticateAsyncEx;
+	void *signInSilentlyAsync;
+	void *pollAuthRequest;
+	void *waitAuthRequest;
+	void *waitAuthRequestPacked;
+	void *freeAuthRequest;
+	void *getAccountCacheStats;
+	void *getBridgeStats;
+	void *getBridgeBuildId;
+	void *logout;
+	void *shutdown;
+} BridgeFunctions;
 */
 import "C"
 
 import (
 	"context"
 	_ "embed"
+	"errors"
 	"fmt"
+	"io"
 	"log"
 	"os"
 	"path/filepath"
+	"runtime"
 	"strings"
+	"sync"
+	"sync/atomic"
+	"syscall"
 	"time"
 	"unsafe"
 
 	"github.com/azure/azure-dev/cli/azd/internal"
+	"github.com/azure/azure-dev/cli/azd/internal/tracing"
+	"github.com/azure/azure-dev/cli/azd/internal/tracing/events"
+	"github.com/azure/azure-dev/cli/azd/internal/tracing/fields"
 
 	"github.com/Azure/azure-sdk-for-go/sdk/azcore"
 	"github.com/Azure/azure-sdk-for-go/sdk/azcore/policy"
+	"go.opentelemetry.io/otel/trace"
 	"golang.org/x/sys/windows"
 )
 
-//export goLog
-func goLog(s *C.char) {
-	log.Print(C.GoString(s))
+//export goAuthComplete
+func goAuthComplete(context C.uintptr_t) {
+	if done, ok := pendingRequests.LoadAndDelete(uint64(context)); ok {
+		close(done.(chan struct{}))
+	}
 }
 
+// silentAuthTimeout bounds the time authnSilent waits for the bridge, which doesn't guarantee an asynchronous
+// request will complete. It matches the bridge's own timeout for synchronous requests.
+const silentAuthTimeout = 60 * time.Second
+
+// tokenRefreshWindow is how long before a cached token's expiration the bridge begins refreshing it in the
+// background. This keeps long-running commands from blocking on token acquisition when tokens roll over.
+const tokenRefreshWindow = 15 * time.Minute
+
+// armScope is the scope of azd's ARM requests, which Warmup acquires
+const armScope = "https://management.azure.com//.default"
+
+// tokenCacheFile is the name of the bridge's token cache file, which shares tokens among azd processes
+const tokenCacheFile = "oneauth-tokens.bin"
+
+// logDrainInterval is how often azd copies log messages buffered by the bridge to its own log
+const logDrainInterval = 250 * time.Millisecond
+
+// bridgeLogLevel and bridgeLogsPerSecond configure the bridge's logging when azd's log is enabled (--debug).
+// Level 3 is information. Otherwise, the bridge doesn't log at all.
+const (
+	bridgeLogLevel      = 3
+	bridgeLogsPerSecond = 500
+)
+
 // Supported indicates whether this build includes OneAuth integration.
 const Supported = true
 
@@ -65,31 +200,285 @@ var (
 	bridgeDLL []byte
 	//go:embed bridge/_build/Release/bridge.dll.sha256
 	bridgeChecksum string
+	//go:embed bridge/_build/Release/bridge.dll.buildid
+	bridgeBuildID string
 	//go:embed bridge/_build/Release/fmt.dll
 	fmtDLL []byte
 	//go:embed bridge/_build/Release/fmt.dll.sha256
 	fmtChecksum string
 
-	// bridge provides access to the OneAuth API
-	bridge         *windows.DLL
-	authenticate   *windows.Proc
-	freeAR         *windows.Proc
-	freeError      *windows.Proc
-	logout         *windows.Proc
-	shutdown       *windows.Proc
-	signInSilently *windows.Proc
-	startup        *windows.Proc
+	// bridge provides access to the OneAuth API. The bridgeFuncs are its exports.
+	bridge            *windows.DLL
+	authenticateAsync bridgeFunc
+	authenticateEx    bridgeFunc
+	cancelAuthn       bridgeFunc
+	configureRefresh  bridgeFunc
+	drainLogs         bridgeFunc
+	freeAR            bridgeFunc
+	freeAuthRequest   bridgeFunc
+	freeError         bridgeFunc
+	freePackedAR      bridgeFunc
+	getAccountStats   bridgeFunc
+	getBridgeStats    bridgeFunc
+	getBuildID        bridgeFunc
+	logout            bridgeFunc
+	openTokenCache    bridgeFunc
+	pollAuthRequest   bridgeFunc
+	setLogOptions     bridgeFunc
+	shutdown          bridgeFunc
+	signInSilently    bridgeFunc
+	startup           bridgeFunc
+	startupAsync      bridgeFunc
+	waitAuthRequest   bridgeFunc
+	warmup            bridgeFunc
+
+	// pendingRequests maps the IDs of asynchronous bridge requests to channels goAuthComplete closes
+	// when the bridge completes the corresponding request
+	pendingRequests sync.Map
+	requestID       atomic.Uint64
+
+	// startMu serializes starting the bridge. startRequest is the bridge's handle for a startup StartAsync began,
+	// until start or Shutdown waits for it. exiting is true after Shutdown, when StartAsync does nothing.
+	startMu      sync.Mutex
+	startRequest uintptr
+	exiting      bool
+
+	// loadOnce guards loading the bridge, which Preload may begin in the background. loadErr is the result.
+	loadOnce sync.Once
+	loadErr  error
+
+	// tokenCacheMu serializes opening the bridge's token cache file. tokenCacheOpened is true when
+	// the file is open and tokenCacheTried is true after the first attempt to open it.
+	tokenCacheMu                      sync.Mutex
+	tokenCacheOpened, tokenCacheTried bool
+
+	// bridgeLogs drains the bridge's log buffer while the bridge is started
+	bridgeLogs = &logDrainer{records: make([]C.LogRecord, 32)}
+
+	// requestBuffers holds native buffers for building AuthenticateRequests
+	requestBuffers = sync.Pool{
+		New: func() any {
+			b := &requestBuffer{}
+			// the pool may drop a buffer at any time, so free its native memory when it's collected
+			runtime.SetFinalizer(b, func(b *requestBuffer) { C.free(b.p) })
+			return b
+		},
+	}
 )
 
+// requestBuffer is a reusable native buffer holding an AuthenticateRequest followed by the request's strings.
+// Reusing these buffers spares token requests the native allocations C.CString would make.
+type requestBuffer struct {
+	p    unsafe.Pointer
+	size int
+}
+
+// fill writes a request for the given parameters to the buffer, growing the buffer if necessary, and returns
+// the request. The request is valid until the next call to fill. A zero deadline or cancellationID means the
+// request has none.
+func (b *requestBuffer) fill(
+	authority, scope, accountID string, allowPrompt bool, deadline time.Time, cancellationID uint64,
+) *C.AuthenticateRequest {
+	n := int(C.sizeof_AuthenticateRequest) + len(authority) + len(scope) + len(accountID)
+	if n > b.size {
+		C.free(b.p)
+		b.size = max(n, 4096)
+		b.p = C.malloc(C.size_t(b.size))
+	}
+	data := unsafe.Slice((*byte)(b.p), b.size)
+	req := (*C.AuthenticateRequest)(b.p)
+	*req = C.AuthenticateRequest{
+		size:           C.sizeof_AuthenticateRequest,
+		allowPrompt:    C.bool(allowPrompt),
+		cancellationID: C.uint64_t(cancellationID),
+	}
+	if !deadline.IsZero() {
+		req.deadline = C.int64_t(deadline.UnixMilli())
+	}
+	off := int(C.sizeof_AuthenticateRequest)
+	req.authority, req.authorityLength, off = putString(data, off, authority)
+	req.accountID, req.accountIDLength, off = putString(data, off, accountID)
+	// OneAuth always appends /.default to scopes
+	start := off
+	for {
+		i := strings.Index(scope, "/.default")
+		if i < 0 {
+			break
+		}
+		off += copy(data[off:], scope[:i])
+		scope = scope[i+len("/.default"):]
+	}
+	off += copy(data[off:], scope)
+	if off > start {
+		req.scope, req.scopeLength = (*C.char)(unsafe.Pointer(&data[start])), C.uint32_t(off-start)
+	}
+	return req
+}
+
+// putString copies s to data at off. It returns a C pointer to the copy, the copy's length and the offset
+// following the copy.
+func putString(data []byte, off int, s string) (*C.char, C.uint32_t, int) {
+	if len(s) == 0 {
+		return nil, 0, off
+	}
+	n := copy(data[off:], s)
+	return (*C.char)(unsafe.Pointer(&data[off])), C.uint32_t(n), off + n
+}
+
 func Shutdown() {
+	startMu.Lock()
+	exiting = true
+	if startRequest != 0 {
+		if done, _, _ := pollAuthRequest.Call(startRequest); done&0xff != 0 {
+			// StartAsync started OneAuth, or tried to, so the bridge may need to shut down
+			_ = awaitStart()
+		} else {
+			// nothing has used the startup StartAsync began, so don't delay azd's exit waiting for it
+			freeAuthRequest.Call(startRequest)
+			startRequest = 0
+		}
+	}
+	startMu.Unlock()
 	if started.CompareAndSwap(true, false) {
+		bridgeLogs.stop()
+		stats := C.AccountCacheStats{}
+		getAccountStats.Call(uintptr(unsafe.Pointer(&stats)))
+		log.Printf("OneAuth bridge account cache: %d hits, %d misses", uint64(stats.hits), uint64(stats.misses))
+		if s, ok := GetBridgeStats(); ok {
+			s.log()
+		}
 		shutdown.Call()
+		// get whatever OneAuth logged while shutting down
+		bridgeLogs.drain()
+	}
+}
+
+// GetBridgeStats returns the bridge's performance counters. It returns false when the bridge isn't started.
+func GetBridgeStats() (BridgeStats, bool) {
+	if !started.Load() || getBridgeStats == 0 {
+		return BridgeStats{}, false
+	}
+	stats := C.BridgeStats{size: C.sizeof_BridgeStats}
+	getBridgeStats.Call(uintptr(unsafe.Pointer(&stats)))
+	return BridgeStats{
+		Startup:           latencyStats(&stats.startup),
+		ReadAccount:       latencyStats(&stats.readAccount),
+		SilentAcquisition: latencyStats(&stats.silentAcquisition),
+		InteractiveSignIn: latencyStats(&stats.interactiveSignIn),
+		PumpIterations:    latencyStats(&stats.pumpIterations),
+		Logout:            latencyStats(&stats.logout),
+		Timeouts:          uint64(stats.timeouts),
+		Errors:            uint64(stats.errors),
+	}, true
+}
+
+func latencyStats(h *C.LatencyHistogram) LatencyStats {
+	s := LatencyStats{
+		Count:   uint64(h.count),
+		Total:   time.Duration(h.totalMicroseconds) * time.Microsecond,
+		Buckets: make([]uint64, len(h.buckets)),
+	}
+	for i, b := range h.buckets {
+		s.Buckets[i] = uint64(b)
+	}
+	return s
+}
+
+// logDrainer copies log messages buffered by the bridge to azd's log. The bridge buffers messages so
+// OneAuth's logging threads don't call into the Go runtime, and azd collects them in batches.
+type logDrainer struct {
+	mu      sync.Mutex
+	records []C.LogRecord
+	// dropped is the number of messages the bridge had dropped as of the last drain
+	dropped uint64
+	done    chan struct{}
+	quit    chan struct{}
+}
+
+// start drains the bridge's log buffer periodically until stop is called
+func (d *logDrainer) start() {
+	d.quit = make(chan struct{})
+	d.done = make(chan struct{})
+	go func() {
+		defer close(d.done)
+		ticker := time.NewTicker(logDrainInterval)
+		defer ticker.Stop()
+		for {
+			select {
+			case <-ticker.C:
+				d.drain()
+			case <-d.quit:
+				d.drain()
+				return
+			}
+		}
+	}()
+}
+
+func (d *logDrainer) stop() {
+	if d.quit != nil {
+		close(d.quit)
+		<-d.done
+		d.quit = nil
+	}
+}
+
+// drain copies all messages in the bridge's log buffer to azd's log
+func (d *logDrainer) drain() {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	for {
+		var dropped C.uint64_t
+		r, _, _ := drainLogs.Call(
+			uintptr(unsafe.Pointer(&d.records[0])), uintptr(len(d.records)), uintptr(unsafe.Pointer(&dropped)),
+		)
+		n := int(r)
+		for i := 0; i < n; i++ {
+			log.Print(C.GoStringN(&d.records[i].message[0], C.int(d.records[i].length)))
+		}
+		if uint64(dropped) > d.dropped {
+			log.Printf("OneAuth bridge dropped %d log messages", uint64(dropped)-d.dropped)
+			d.dropped = uint64(dropped)
+		}
+		if n < len(d.records) {
+			return
+		}
 	}
 }
 
 type authResult struct {
 	homeAccountID string
 	token         azcore.AccessToken
+	// correlationID identifies the OneAuth request that produced the result. It's empty when the bridge
+	// didn't call OneAuth, for example because it had the token cached.
+	correlationID string
+	timings       authTimings
+}
+
+// authTimings are the durations of the phases of a bridge call. Phases the call didn't go through are 0.
+type authTimings struct {
+	accountLookup, silentWait, pump, marshal time.Duration
+}
+
+// trace records a span for a token request that reached OneAuth, so slow requests can be correlated with
+// OneAuth's logs. start is when the request began.
+func (ar authResult) trace(ctx context.Context, start time.Time, err error) {
+	if ar.correlationID == "" {
+		return
+	}
+	log.Printf(
+		"OneAuth request %s: account lookup %s, silent wait %s, pump %s, marshal %s",
+		ar.correlationID, ar.timings.accountLookup, ar.timings.silentWait, ar.timings.pump, ar.timings.marshal,
+	)
+	_, span := tracing.Start(ctx, events.OneAuthTokenEvent, trace.WithTimestamp(start))
+	span.SetAttributes(
+		fields.OneAuthCorrelationId.String(ar.correlationID),
+		fields.OneAuthAccountLookupTime.Int64(ar.timings.accountLookup.Microseconds()),
+		fields.OneAuthSilentWaitTime.Int64(ar.timings.silentWait.Microseconds()),
+		fields.OneAuthPumpTime.Int64(ar.timings.pump.Microseconds()),
+		fields.OneAuthMarshalTime.Int64(ar.timings.marshal.Microseconds()),
+	)
+	span.EndWithStatus(err)
 }
 
 type credential struct {
@@ -113,7 +502,27 @@ func NewCredential(authority, clientID string, opts CredentialOptions) (azcore.T
 // GetToken acquires a token from OneAuth. If doing so requires user interaction and NoPrompt is true, it returns
 // an error. Otherwise, OneAuth will display a login window and this call must occur on the main thread.
 func (c *credential) GetToken(ctx context.Context, opts policy.TokenRequestOptions) (azcore.AccessToken, error) {
-	ar, err := authn(c.authority, c.clientID, c.homeAccountID, strings.Join(opts.Scopes, " "), c.opts.NoPrompt)
+	var (
+		ar  authResult
+		err error
+	)
+	scope := strings.Join(opts.Scopes, " ")
+	start := time.Now()
+	if !started.Load() {
+		// an earlier azd process may have cached the token, in which case OneAuth needn't start at all
+		if ar, ok := cachedToken(c.authority, c.clientID, c.homeAccountID, scope); ok {
+			c.homeAccountID = ar.homeAccountID
+			return ar.token, nil
+		}
+	}
+	if c.opts.NoPrompt {
+		// silent authentication doesn't need this goroutine's thread, so it needn't block the thread
+		// while waiting for OneAuth
+		ar, err = authnSilent(ctx, c.authority, c.clientID, c.homeAccountID, scope)
+	} else {
+		ar, err = authn(ctx, c.authority, c.clientID, c.homeAccountID, scope, false)
+	}
+	ar.trace(ctx, start, err)
 	if err == nil {
 		c.homeAccountID = ar.homeAccountID
 	}
@@ -121,7 +530,7 @@ func (c *credential) GetToken(ctx context.Context, opts policy.TokenRequestOptio
 }
 
 func LogIn(authority, clientID, scope string) (string, error) {
-	ar, err := authn(authority, clientID, "", scope, false)
+	ar, err := authn(context.Background(), authority, clientID, "", scope, false)
 	return ar.homeAccountID, err
 }
 
@@ -152,124 +561,406 @@ func LogInSilently(clientID string) (string, error) {
 	return accountID, err
 }
 
+// openTokenCacheFile loads the bridge, if necessary, and opens its token cache file for the given client. It returns
+// true when the file is open. azd works without the file, so failing to open it isn't an error.
+func openTokenCacheFile(clientID string) bool {
+	tokenCacheMu.Lock()
+	defer tokenCacheMu.Unlock()
+	if tokenCacheTried {
+		return tokenCacheOpened
+	}
+	dir, err := bridgeDir()
+	if err == nil {
+		err = loadDLL()
+	}
+	if err != nil {
+		return false
+	}
+	tokenCacheTried = true
+	path := unsafe.Pointer(C.CString(filepath.Join(dir, tokenCacheFile)))
+	defer C.free(path)
+	id := unsafe.Pointer(C.CString(clientID))
+	defer C.free(id)
+	p, _, _ := openTokenCache.Call(uintptr(path), uintptr(id))
+	if p != 0 {
+		defer freeError.Call(p)
+		log.Printf("couldn't open OneAuth token cache: %s", C.GoString((*C.WrappedError)(unsafe.Pointer(p)).message))
+		return false
+	}
+	tokenCacheOpened = true
+	return true
+}
+
+// cachedToken returns a token from the bridge's token caches without starting OneAuth. It returns false when
+// neither cache has a usable token.
+func cachedToken(authority, clientID, homeAccountID, scope string) (authResult, bool) {
+	if homeAccountID == "" || !openTokenCacheFile(clientID) {
+		return authResult{}, false
+	}
+	b := requestBuffers.Get().(*requestBuffer)
+	defer requestBuffers.Put(b)
+	r := b.fill(authority, scope, homeAccountID, false, time.Time{}, 0)
+	r.cacheOnly = true
+	p, _, _ := authenticateEx.Call(uintptr(unsafe.Pointer(r)))
+	ar, err := unpackAuthResult(p)
+	return ar, err == nil
+}
+
+// StartAsync begins starting OneAuth in the background, so that the first token request waits only for whatever
+// startup work remains. azd calls it before dispatching a command when the current user logged in with OneAuth, and
+// Warmup calls it when the token cache file can't satisfy azd's first ARM request. It does nothing after Shutdown.
+func StartAsync(clientID string) {
+	if started.Load() {
+		return
+	}
+	startMu.Lock()
+	defer startMu.Unlock()
+	if started.Load() || startRequest != 0 || exiting {
+		return
+	}
+	if err := prepareStart(clientID); err != nil {
+		log.Printf("couldn't start OneAuth: %v", err)
+		return
+	}
+	args, free := startupArgs(clientID)
+	defer free()
+	// the bridge waits for this startup before calling OneAuth, so requests needn't wait for it here
+	startRequest, _, _ = startupAsync.Call(args[0], args[1], args[2], 0, 0, 0)
+}
+
+// Warmup prepares OneAuth for azd's first ARM request in the background. Unless the bridge's token cache file already
+// has an ARM token for the given account, Warmup starts OneAuth, as StartAsync does, and has the bridge silently acquire
+// the token, so the token is cached by the time azd requests it. Nothing waits for the token; if the bridge can't
+// acquire it, azd's request will try again and report the error.
+func Warmup(authority, clientID, homeAccountID string) {
+	if homeAccountID == "" {
+		return
+	}
+	// loading the bridge and reading its token cache file take time the caller needn't spend
+	go func() {
+		if _, ok := cachedToken(authority, clientID, homeAccountID, armScope); ok {
+			// an earlier process acquired the token, so this one may not need OneAuth at all
+			return
+		}
+		StartAsync(clientID)
+		startMu.Lock()
+		defer startMu.Unlock()
+		if !started.Load() && startRequest == 0 {
+			// StartAsync failed to load the bridge
+			return
+		}
+		a := unsafe.Pointer(C.CString(authority))
+		defer C.free(a)
+		id := unsafe.Pointer(C.CString(homeAccountID))
+		defer C.free(id)
+		// a NULL scope is the ARM scope
+		warmup.Call(uintptr(a), 0, uintptr(id))
+	}()
+}
+
 func start(clientID string) error {
-	if started.CompareAndSwap(false, true) {
-		err := loadDLL()
-		if err != nil {
-			return err
+	if started.Load() {
+		return nil
+	}
+	startMu.Lock()
+	defer startMu.Unlock()
+	if started.Load() {
+		return nil
+	}
+	if startRequest != 0 {
+		// StartAsync started OneAuth, or tried to. If it failed, try again below.
+		if err := awaitStart(); err == nil {
+			return nil
 		}
-		clientID := unsafe.Pointer(C.CString(clientID))
-		defer C.free(clientID)
-		appID := unsafe.Pointer(C.CString(applicationID))
-		defer C.free(appID)
-		v := unsafe.Pointer(C.CString(internal.VersionInfo().Version.String()))
-		defer C.free(v)
-		p, _, _ := startup.Call(
-			uintptr(clientID),
-			uintptr(appID),
-			uintptr(v),
-			uintptr(unsafe.Pointer(C.goLogGateway)),
-		)
-		// startup returns a char* message when it fails
-		if p != 0 {
-			// reset started so the next call will try to start OneAuth again
-			started.CompareAndSwap(true, false)
-			defer freeError.Call(p)
-			wrapped := (*C.WrappedError)(unsafe.Pointer(p))
-			return fmt.Errorf("couldn't start OneAuth: %s", C.GoString(wrapped.message))
+	}
+	if err := prepareStart(clientID); err != nil {
+		return err
+	}
+	args, free := startupArgs(clientID)
+	defer free()
+	p, _, _ := startup.Call(
+		args[0],
+		args[1],
+		args[2],
+		0, // no log callback; bridgeLogs drains the bridge's log buffer instead
+	)
+	// startup returns a char* message when it fails
+	if p != 0 {
+		bridgeLogs.drain()
+		defer freeError.Call(p)
+		wrapped := (*C.WrappedError)(unsafe.Pointer(p))
+		return fmt.Errorf("couldn't start OneAuth: %s", C.GoString(wrapped.message))
+	}
+	onStarted()
+	return nil
+}
+
+// prepareStart loads the bridge and configures it for Startup or StartupAsync
+func prepareStart(clientID string) error {
+	// this loads the bridge, so the file is open before the bridge acquires any tokens
+	openTokenCacheFile(clientID)
+	if err := loadDLL(); err != nil {
+		return err
+	}
+	// when azd discards its log, OneAuth needn't format log messages at all
+	if log.Writer() != io.Discard {
+		setLogOptions.Call(bridgeLogLevel, bridgeLogsPerSecond)
+	} else {
+		setLogOptions.Call(0, 0)
+	}
+	return nil
+}
+
+// startupArgs returns the clientId, applicationId and version arguments of Startup and StartupAsync, and a
+// function that frees them
+func startupArgs(clientID string) ([3]uintptr, func()) {
+	args := [3]unsafe.Pointer{
+		unsafe.Pointer(C.CString(clientID)),
+		unsafe.Pointer(C.CString(applicationID)),
+		unsafe.Pointer(C.CString(internal.VersionInfo().Version.String())),
+	}
+	return [3]uintptr{uintptr(args[0]), uintptr(args[1]), uintptr(args[2])}, func() {
+		for _, a := range args {
+			C.free(a)
 		}
 	}
+}
+
+// awaitStart waits for the startup StartAsync began. startMu must be held.
+func awaitStart() error {
+	req := startRequest
+	startRequest = 0
+	defer freeAuthRequest.Call(req)
+	p, _, _ := waitAuthRequest.Call(req, uintptr(silentAuthTimeout/time.Millisecond))
+	if p == 0 {
+		return fmt.Errorf("timed out waiting for OneAuth to start")
+	}
+	if _, err := unpackAuthResult(p); err != nil {
+		bridgeLogs.drain()
+		return fmt.Errorf("couldn't start OneAuth: %w", err)
+	}
+	onStarted()
 	return nil
 }
 
-func authn(authority, clientID, homeAccountID, scope string, noPrompt bool) (authResult, error) {
+// onStarted configures the bridge after OneAuth starts
+func onStarted() {
+	started.Store(true)
+	configureRefresh.Call(uintptr(tokenRefreshWindow / time.Second))
+	if log.Writer() != io.Discard {
+		bridgeLogs.start()
+	}
+}
+
+// authn authenticates synchronously. The bridge stops waiting at ctx's deadline, and cancelling ctx cancels
+// the request. Cancelling doesn't close a login window OneAuth displayed.
+func authn(ctx context.Context, authority, clientID, homeAccountID, scope string, noPrompt bool) (authResult, error) {
 	res := authResult{}
+	if err := ctx.Err(); err != nil {
+		return res, err
+	}
 	if err := start(clientID); err != nil {
 		return res, err
 	}
-	a := unsafe.Pointer(C.CString(authority))
-	defer C.free(a)
-	accountID := unsafe.Pointer(C.CString(homeAccountID))
-	defer C.free(accountID)
-	// OneAuth always appends /.default to scopes
-	scope = strings.ReplaceAll(scope, "/.default", "")
-	scp := unsafe.Pointer(C.CString(scope))
-	defer C.free(scp)
-	allowPrompt := 1
-	if noPrompt {
-		allowPrompt = 0
-	}
-	p, _, _ := authenticate.Call(uintptr(a), uintptr(scp), uintptr(accountID), uintptr(allowPrompt))
+	deadline, _ := ctx.Deadline()
+	id := requestID.Add(1)
+	b := requestBuffers.Get().(*requestBuffer)
+	defer requestBuffers.Put(b)
+	req := b.fill(authority, scope, homeAccountID, !noPrompt, deadline, id)
+	stop := context.AfterFunc(ctx, func() { cancelAuthn.Call(uintptr(id)) })
+	defer stop()
+	p, _, _ := authenticateEx.Call(uintptr(unsafe.Pointer(req)))
+	return unpackAuthResult(p)
+}
+
+// authnSilent is a non-blocking version of authn for silent authentication. It starts an asynchronous request
+// and waits for the bridge to signal completion, so the calling goroutine's thread isn't blocked in native code.
+func authnSilent(ctx context.Context, authority, clientID, homeAccountID, scope string) (authResult, error) {
+	if err := start(clientID); err != nil {
+		return authResult{}, err
+	}
+	b := requestBuffers.Get().(*requestBuffer)
+	defer requestBuffers.Put(b)
+	r := b.fill(authority, scope, homeAccountID, false, time.Time{}, 0)
+
+	id := requestID.Add(1)
+	done := make(chan struct{})
+	pendingRequests.Store(id, done)
+	defer pendingRequests.Delete(id)
+	req, _, _ := authenticateAsync.Call(
+		uintptr(unsafe.Pointer(r)), uintptr(unsafe.Pointer(C.goAuthCompleteGateway)), uintptr(id),
+	)
+	if req == 0 {
+		return authResult{}, fmt.Errorf("authentication failed")
+	}
+	defer freeAuthRequest.Call(req)
+
+	select {
+	case <-done:
+	case <-ctx.Done():
+		return authResult{}, ctx.Err()
+	case <-time.After(silentAuthTimeout):
+		return authResult{}, fmt.Errorf("timed out waiting for silent authentication")
+	}
+	p, _, _ := waitAuthRequest.Call(req, 0)
+	return unpackAuthResult(p)
+}
+
+// unpackAuthResult copies a PackedAuthResult returned by the bridge into an authResult and frees it
+func unpackAuthResult(p uintptr) (authResult, error) {
+	res := authResult{}
 	if p == 0 {
 		// this shouldn't happen but if it did, this vague error would be better than a panic
 		return res, fmt.Errorf("authentication failed")
 	}
-	defer freeAR.Call(p)
+	defer freePackedAR.Call(p)
 
-	wrapped := (*C.WrappedAuthResult)(unsafe.Pointer(p))
-	if wrapped.errorDescription != nil {
-		return res, fmt.Errorf(C.GoString(wrapped.errorDescription))
+	packed := (*C.PackedAuthResult)(unsafe.Pointer(p))
+	if packed.correlationID != nil {
+		res.correlationID = C.GoStringN(packed.correlationID, C.int(packed.correlationIDLength))
+	}
+	res.timings = authTimings{
+		accountLookup: time.Duration(packed.accountLookupMicroseconds) * time.Microsecond,
+		silentWait:    time.Duration(packed.silentWaitMicroseconds) * time.Microsecond,
+		pump:          time.Duration(packed.pumpMicroseconds) * time.Microsecond,
+		marshal:       time.Duration(packed.marshalMicroseconds) * time.Microsecond,
 	}
-	if wrapped.accountID != nil {
-		res.homeAccountID = C.GoString(wrapped.accountID)
+	if packed.errorLength > 0 {
+		return res, errors.New(C.GoStringN(packed.error, C.int(packed.errorLength)))
 	}
-	if wrapped.token != nil {
-		res.token = azcore.AccessToken{
-			ExpiresOn: time.Unix(int64(wrapped.expiresOn), 0),
-			Token:     C.GoString(wrapped.token),
+	if packed.accountID == nil || packed.token == nil {
+		if packed.accountID != nil {
+			res.homeAccountID = C.GoStringN(packed.accountID, C.int(packed.accountIDLength))
 		}
+		return res, nil
+	}
+	// the account ID and token are adjacent, separated by a NUL, so one copy gets both
+	n := int(packed.accountIDLength)
+	s := C.GoStringN(packed.accountID, C.int(n+1+int(packed.tokenLength)))
+	res.homeAccountID = s[:n]
+	res.token = azcore.AccessToken{
+		ExpiresOn: time.Unix(int64(packed.expiresOn), 0),
+		Token:     s[n+1:],
 	}
-
 	return res, nil
 }
 
-// loadDLL loads the bridge DLL and its dependencies, writing them to disk if necessary.
+// Preload extracts and loads the bridge in the background, so that azd's first use of OneAuth needn't wait for
+// either. azd calls it at process start.
+func Preload() {
+	go func() {
+		_ = loadDLL()
+	}()
+}
+
+// loadDLL loads the bridge DLL and its dependencies, writing them to disk if necessary. Only the first call does
+// so; later calls wait for it to finish and return its result.
 func loadDLL() error {
-	if bridge != nil {
-		return nil
-	}
-	// cacheDir is %LocalAppData%
-	cacheDir, err := os.UserCacheDir()
+	loadOnce.Do(func() {
+		// a test may have loaded a bridge already
+		if bridge == nil {
+			loadErr = extractBridge()
+		}
+	})
+	return loadErr
+}
+
+// extractBridge validates the embedded DLLs' copies on disk, rewriting them if necessary, and loads the bridge
+func extractBridge() error {
+	dir, err := bridgeDir()
 	if err != nil {
 		return err
 	}
-	dir := filepath.Join(cacheDir, "azd")
-	for _, dll := range []struct {
-		name, checksum string
-		data           []byte
-	}{
+	libs := []dynamicLib{
 		{name: "fmt.dll", checksum: fmtChecksum, data: fmtDLL},
 		{name: "bridge.dll", checksum: bridgeChecksum, data: bridgeDLL},
-	} {
-		p := filepath.Join(dir, dll.name)
-		err = writeDynamicLib(p, dll.data, dll.checksum)
-		if err != nil {
-			return fmt.Errorf("writing %s: %w", p, err)
-		}
+	}
+	buildID := strings.TrimSpace(bridgeBuildID)
+	if err := writeDynamicLibs(dir, buildID, libs); err != nil {
+		return err
 	}
 	p := filepath.Join(dir, "bridge.dll")
-	h, err := windows.LoadLibraryEx(p, 0, windows.LOAD_LIBRARY_SEARCH_DEFAULT_DIRS|windows.LOAD_LIBRARY_SEARCH_DLL_LOAD_DIR)
-	if err == nil {
-		bridge = &windows.DLL{Handle: h, Name: p}
-		authenticate, err = bridge.FindProc("Authenticate")
+	if err := loadBridge(p); err == nil && loadedBuildID() == buildID {
+		return nil
 	}
-	if err == nil {
-		freeAR, err = bridge.FindProc("FreeWrappedAuthResult")
+	// the build ID file misrepresented the DLLs, e.g. because something replaced one, so compare their checksums
+	unloadBridge()
+	if err := writeDynamicLibs(dir, "", libs); err != nil {
+		return err
 	}
-	if err == nil {
-		freeError, err = bridge.FindProc("FreeWrappedError")
+	return loadBridge(p)
+}
+
+// loadedBuildID returns the build ID of the loaded bridge
+func loadedBuildID() string {
+	p, _, _ := getBuildID.Call()
+	return C.GoString((*C.char)(unsafe.Pointer(p)))
+}
+
+// unloadBridge unloads the bridge DLL, if it's loaded. The bridge must not be started.
+func unloadBridge() {
+	if bridge != nil {
+		_ = bridge.Release()
+		bridge = nil
 	}
-	if err == nil {
-		logout, err = bridge.FindProc("Logout")
+}
+
+// bridgeDir returns the directory holding the bridge DLL and its token cache file, %LocalAppData%\azd
+func bridgeDir() (string, error) {
+	cacheDir, err := os.UserCacheDir()
+	if err != nil {
+		return "", err
 	}
-	if err == nil {
-		shutdown, err = bridge.FindProc("Shutdown")
+	return filepath.Join(cacheDir, "azd"), nil
+}
+
+// loadBridge loads the bridge DLL at path p and finds its exports
+func loadBridge(p string) error {
+	h, err := windows.LoadLibraryEx(p, 0, windows.LOAD_LIBRARY_SEARCH_DEFAULT_DIRS|windows.LOAD_LIBRARY_SEARCH_DLL_LOAD_DIR)
+	if err != nil {
+		return err
 	}
-	if err == nil {
-		signInSilently, err = bridge.FindProc("SignInSilently")
+	bridge = &windows.DLL{Handle: h, Name: p}
+	// one lookup finds every export
+	getFunctions, err := bridge.FindProc("GetBridgeFunctions")
+	if err != nil {
+		return err
 	}
-	if err == nil {
-		startup, err = bridge.FindProc("Startup")
+	fs := C.BridgeFunctions{size: C.sizeof_BridgeFunctions}
+	getFunctions.Call(uintptr(unsafe.Pointer(&fs)))
+	if fs.shutdown == nil {
+		return fmt.Errorf("%s doesn't provide the expected functions", p)
 	}
-	return err
+	authenticateAsync = bridgeFunc(fs.authenticateAsyncEx)
+	authenticateEx = bridgeFunc(fs.authenticateEx)
+	cancelAuthn = bridgeFunc(fs.cancelAuthenticate)
+	configureRefresh = bridgeFunc(fs.configureTokenRefresh)
+	drainLogs = bridgeFunc(fs.drainLogs)
+	freeAR = bridgeFunc(fs.freeWrappedAuthResult)
+	freeAuthRequest = bridgeFunc(fs.freeAuthRequest)
+	freeError = bridgeFunc(fs.freeWrappedError)
+	freePackedAR = bridgeFunc(fs.freePackedAuthResult)
+	getAccountStats = bridgeFunc(fs.getAccountCacheStats)
+	getBridgeStats = bridgeFunc(fs.getBridgeStats)
+	getBuildID = bridgeFunc(fs.getBridgeBuildId)
+	logout = bridgeFunc(fs.logout)
+	openTokenCache = bridgeFunc(fs.openTokenCacheFile)
+	pollAuthRequest = bridgeFunc(fs.pollAuthRequest)
+	setLogOptions = bridgeFunc(fs.setLogOptions)
+	shutdown = bridgeFunc(fs.shutdown)
+	signInSilently = bridgeFunc(fs.signInSilently)
+	startup = bridgeFunc(fs.startup)
+	startupAsync = bridgeFunc(fs.startupAsync)
+	waitAuthRequest = bridgeFunc(fs.waitAuthRequestPacked)
+	warmup = bridgeFunc(fs.warmup)
+	return nil
+}
+
+// bridgeFunc is the address of a bridge export
+type bridgeFunc uintptr
+
+// Call calls the export as windows.Proc.Call would
+func (f bridgeFunc) Call(args ...uintptr) (uintptr, uintptr, error) {
+	r1, r2, errno := syscall.SyscallN(uintptr(f), args...)
+	return r1, r2, errno
 }
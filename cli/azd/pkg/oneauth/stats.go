@@ -0,0 +1,92 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+package oneauth
+
+import (
+	"log"
+	"time"
+
+	"github.com/azure/azure-dev/cli/azd/internal/tracing/fields"
+	"go.opentelemetry.io/otel/attribute"
+)
+
+// LatencyStats summarizes the durations of a bridge operation
+type LatencyStats struct {
+	Count uint64
+	Total time.Duration
+	// Buckets is a histogram of durations. Buckets[0] counts operations taking less than 1ms, Buckets[i]
+	// those taking at least 2^(i-1)ms and less than 2^i ms, and the last bucket all longer operations.
+	Buckets []uint64
+}
+
+// Mean returns the mean duration of the operation
+func (s LatencyStats) Mean() time.Duration {
+	if s.Count == 0 {
+		return 0
+	}
+	return s.Total / time.Duration(s.Count)
+}
+
+// BridgeStats are the OneAuth bridge's performance counters
+type BridgeStats struct {
+	Startup           LatencyStats
+	ReadAccount       LatencyStats
+	SilentAcquisition LatencyStats
+	InteractiveSignIn LatencyStats
+	// PumpIterations times the message dispatching of the login window's message pump
+	PumpIterations LatencyStats
+	Logout         LatencyStats
+	// Timeouts counts requests the bridge stopped waiting for
+	Timeouts uint64
+	// Errors counts OneAuth results having an error
+	Errors uint64
+}
+
+// Attributes returns the stats as telemetry attributes, omitting operations that didn't happen
+func (s BridgeStats) Attributes() []attribute.KeyValue {
+	attrs := []attribute.KeyValue{
+		fields.OneAuthTimeouts.Int64(int64(s.Timeouts)),
+		fields.OneAuthErrors.Int64(int64(s.Errors)),
+	}
+	for _, op := range s.operations() {
+		if op.stats.Count > 0 {
+			buckets := make([]int64, len(op.stats.Buckets))
+			for i, b := range op.stats.Buckets {
+				buckets[i] = int64(b)
+			}
+			attrs = append(attrs, op.key.Int64Slice(buckets))
+		}
+	}
+	return attrs
+}
+
+type operationStats struct {
+	name  string
+	key   attribute.Key
+	stats LatencyStats
+}
+
+func (s BridgeStats) operations() []operationStats {
+	return []operationStats{
+		{"startup", fields.OneAuthStartupDurations, s.Startup},
+		{"read account", fields.OneAuthReadAccountDurations, s.ReadAccount},
+		{"silent acquisition", fields.OneAuthSilentDurations, s.SilentAcquisition},
+		{"interactive sign in", fields.OneAuthInteractiveDurations, s.InteractiveSignIn},
+		{"pump iteration", fields.OneAuthPumpDurations, s.PumpIterations},
+		{"logout", fields.OneAuthLogoutDurations, s.Logout},
+	}
+}
+
+// log writes the stats to azd's log
+func (s BridgeStats) log() {
+	for _, op := range s.operations() {
+		if op.stats.Count > 0 {
+			log.Printf(
+				"OneAuth bridge %s: %d calls, mean %s, histogram %v",
+				op.name, op.stats.Count, op.stats.Mean(), op.stats.Buckets,
+			)
+		}
+	}
+	log.Printf("OneAuth bridge: %d timeouts, %d errors", s.Timeouts, s.Errors)
+}
@@ -0,0 +1,28 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+package oneauth
+
+import (
+	"testing"
+	"time"
+
+	"github.com/azure/azure-dev/cli/azd/internal/tracing/fields"
+	"github.com/stretchr/testify/require"
+)
+
+func TestBridgeStatsAttributes(t *testing.T) {
+	stats := BridgeStats{
+		SilentAcquisition: LatencyStats{Count: 2, Total: 30 * time.Millisecond, Buckets: []uint64{0, 0, 0, 1, 0, 1}},
+		Timeouts:          1,
+	}
+	require.Equal(t, 15*time.Millisecond, stats.SilentAcquisition.Mean())
+	require.Zero(t, stats.Startup.Mean())
+
+	attrs := stats.Attributes()
+	require.Contains(t, attrs, fields.OneAuthTimeouts.Int64(1))
+	require.Contains(t, attrs, fields.OneAuthErrors.Int64(0))
+	require.Contains(t, attrs, fields.OneAuthSilentDurations.Int64Slice([]int64{0, 0, 0, 1, 0, 1}))
+	// operations that didn't happen are omitted
+	require.Len(t, attrs, 3)
+}
@@ -9,10 +9,13 @@ import (
 	"bytes"
 	"crypto/sha256"
 	"encoding/hex"
+	"errors"
 	"fmt"
+	"io/fs"
 	"os"
 	"path/filepath"
 	"strings"
+	"sync"
 	"sync/atomic"
 )
 
@@ -22,6 +25,83 @@ const applicationID = "com.microsoft.azd"
 // because OneAuth returns an error when its Startup function is called more than once.
 var started atomic.Bool
 
+// buildIDFile is the name of the file recording the build ID of the bridge azd last extracted, and the size and
+// modification time of each DLL it extracted
+const buildIDFile = "bridge.buildid"
+
+// dynamicLib is a DLL azd embeds and extracts to disk
+type dynamicLib struct {
+	name string
+	data []byte
+	// checksum is the output of "cmake -E sha256sum" for the DLL
+	checksum string
+}
+
+// writeDynamicLibs extracts libs to dir. When dir's build ID file records buildID, and the size and modification time
+// of each DLL in dir, the DLLs are current and writeDynamicLibs doesn't read them. Otherwise, it concurrently compares
+// each DLL's checksum to the embedded one and rewrites the DLLs that differ. An empty buildID forces the comparison.
+func writeDynamicLibs(dir, buildID string, libs []dynamicLib) error {
+	stamp := filepath.Join(dir, buildIDFile)
+	if buildID != "" && stampCurrent(dir, stamp, buildID, libs) {
+		return nil
+	}
+	// hashing dominates, so validate the DLLs concurrently
+	errs := make([]error, len(libs))
+	wg := sync.WaitGroup{}
+	for i, lib := range libs {
+		wg.Add(1)
+		go func(i int, lib dynamicLib) {
+			defer wg.Done()
+			p := filepath.Join(dir, lib.name)
+			if err := writeDynamicLib(p, lib.data, lib.checksum); err != nil {
+				errs[i] = fmt.Errorf("writing %s: %w", p, err)
+			}
+		}(i, lib)
+	}
+	wg.Wait()
+	if err := errors.Join(errs...); err != nil {
+		return err
+	}
+	if buildID == "" {
+		if err := os.Remove(stamp); err != nil && !errors.Is(err, fs.ErrNotExist) {
+			return err
+		}
+		return nil
+	}
+	// write the build ID last, so it's current only when every DLL is
+	content, err := stampContent(dir, buildID, libs)
+	if err != nil {
+		return err
+	}
+	return os.WriteFile(stamp, []byte(content), 0600)
+}
+
+// stampCurrent returns true when the build ID file at stamp records buildID and the current size and modification
+// time of each of libs in dir
+func stampCurrent(dir, stamp, buildID string, libs []dynamicLib) bool {
+	b, err := os.ReadFile(stamp)
+	if err != nil {
+		return false
+	}
+	content, err := stampContent(dir, buildID, libs)
+	return err == nil && string(b) == content
+}
+
+// stampContent returns the content of a build ID file for buildID and libs as they are in dir. The first line is
+// the build ID; each other line is a DLL's name, size and modification time in nanoseconds since the Unix epoch.
+func stampContent(dir, buildID string, libs []dynamicLib) (string, error) {
+	sb := strings.Builder{}
+	sb.WriteString(buildID)
+	for _, lib := range libs {
+		fi, err := os.Stat(filepath.Join(dir, lib.name))
+		if err != nil {
+			return "", err
+		}
+		fmt.Fprintf(&sb, "\n%s %d %d", lib.name, fi.Size(), fi.ModTime().UnixNano())
+	}
+	return sb.String(), nil
+}
+
 // writeDynamicLib writes data to path if path doesn't exist or its content doesn't match
 // cmakeChecksum (the output of "cmake -E sha256sum").
 func writeDynamicLib(path string, data []byte, cmakeChecksum string) error {
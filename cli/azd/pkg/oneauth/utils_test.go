@@ -0,0 +1,62 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+//go:build oneauth
+
+package oneauth
+
+import (
+	"crypto/sha256"
+	"encoding/hex"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/require"
+)
+
+func TestWriteDynamicLibs(t *testing.T) {
+	data := []byte("bridge")
+	sum := sha256.Sum256(data)
+	libs := []dynamicLib{{name: "bridge.dll", data: data, checksum: hex.EncodeToString(sum[:]) + " bridge.dll"}}
+	dir := t.TempDir()
+	p := filepath.Join(dir, "bridge.dll")
+
+	require.NoError(t, writeDynamicLibs(dir, "id", libs))
+	b, err := os.ReadFile(p)
+	require.NoError(t, err)
+	require.Equal(t, data, b)
+	b, err = os.ReadFile(filepath.Join(dir, buildIDFile))
+	require.NoError(t, err)
+	id, _, _ := strings.Cut(string(b), "\n")
+	require.Equal(t, "id", id)
+
+	// when the build ID is current, writeDynamicLibs checks only the DLL's size and modification time, so it
+	// rewrites a DLL whose content changed even when its size didn't
+	require.NoError(t, os.WriteFile(p, []byte("BRIDGE"), 0600))
+	// set the time explicitly because some file systems have coarse timestamps
+	modified := time.Now().Add(-time.Hour)
+	require.NoError(t, os.Chtimes(p, modified, modified))
+	require.NoError(t, writeDynamicLibs(dir, "id", libs))
+	b, err = os.ReadFile(p)
+	require.NoError(t, err)
+	require.Equal(t, data, b)
+
+	// otherwise, it compares checksums
+	require.NoError(t, writeDynamicLibs(dir, "other", libs))
+	b, err = os.ReadFile(p)
+	require.NoError(t, err)
+	require.Equal(t, data, b)
+
+	require.NoError(t, os.WriteFile(p, []byte("bridge2"), 0600))
+	require.NoError(t, writeDynamicLibs(dir, "other", libs))
+	b, err = os.ReadFile(p)
+	require.NoError(t, err)
+	require.Equal(t, data, b)
+
+	// an empty build ID forces the comparison and removes the build ID file
+	require.NoError(t, writeDynamicLibs(dir, "", libs))
+	require.NoFileExists(t, filepath.Join(dir, buildIDFile))
+}